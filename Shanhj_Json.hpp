@@ -1,29 +1,66 @@
 #ifndef SHANHJ_JSON_H
 #define SHANHJ_JSON_H
 
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+// 定义SHANHJ_JSON_ZLIB后JsonArrayReader可以直接读取gzip压缩的文件，需要链接zlib（-lz）
+#ifdef SHANHJ_JSON_ZLIB
+#include <zlib.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SHANHJ_JSON_HAS_MMAP
+#endif
 
 namespace Shanhj_Json
 {
-#define parser_array_check(array_begin, array_end) \
-    if (array_begin >= array_end)                  \
-    {                                              \
-        result = false;                            \
-        return array_begin;                        \
-    }
-
     using namespace std;
 
     typedef unsigned long ulong;
 
     class JsonArray;
     class JsonObject;
+    class JsonValue;
+    class JsonVisitor;
+    class Parser;
+    class JsonPatch;
+    class JsonColumn;
+    class StaticValue;
+    class JsonSchema;
+    class JsonProjection;
+    class FrozenJson;
+    class ParallelOutput;
 
     enum value_type
     {
@@ -33,9 +70,117 @@ namespace Shanhj_Json
         TYPE_BOOLEAN,
         TYPE_OBJECT,
         TYPE_ARRAY,
-        TYPE_NULL
+        TYPE_NULL,
+        TYPE_NUMBER // 保留原文的数字，只在Parser::raw_numbers开启时由解析产生
+    };
+
+    // 保留原文的数字的分类
+    enum number_kind
+    {
+        NUMBER_INT64,   // 在int64_t范围内的整数
+        NUMBER_BIG_INT, // 超出int64_t范围的整数
+        NUMBER_FLOAT    // 有小数部分或指数部分
+    };
+
+    // 数字原文在所在容器的number_text中的位置以及数字的分类，读取时才转换，输出时原样写回
+    struct raw_number
+    {
+        ulong offset;
+        ulong length;
+        number_kind kind;
+    };
+
+    // 一段连续存放的只读元素，相当于C++20的span<const T>，不拥有数据，所属的数组被修改后失效
+    template <typename T>
+    class typed_span
+    {
+    public:
+        typed_span() = default;
+        typed_span(const T *data, ulong size) : pointer(data), length(size) {}
+        typed_span(const vector<T> &values) : pointer(values.data()), length(values.size()) {}
+
+        const T *data() const { return pointer; }
+        ulong size() const { return length; }
+        bool empty() const { return length == 0; }
+        const T *begin() const { return pointer; }
+        const T *end() const { return pointer + length; }
+        const T &operator[](ulong index) const { return pointer[index]; }
+
+    private:
+        const T *pointer = nullptr;
+        ulong length = 0;
+    };
+
+    // 解析时的各项限制，超出任意一项即视为解析出错
+    struct parse_limits
+    {
+        ulong max_depth = 1024;              // 最大嵌套深度，最外层的对象或数组深度为1
+        ulong max_nodes = ULONG_MAX;         // 最多能包含的值的个数，对象和数组本身也计算在内
+        ulong max_string_length = ULONG_MAX; // 单个字符串（包括键）转义后的最大字节数
+        ulong max_document_size = ULONG_MAX; // 输入的最大字节数
+    };
+
+    enum error_code
+    {
+        ERROR_NONE,             // 没有错误
+        ERROR_UNEXPECTED_TOKEN, // 出现了不符合语法的字符
+        ERROR_BAD_ESCAPE,       // 字符串中有不合法的转义字符
+        ERROR_BAD_NUMBER,       // 数字格式错误
+        ERROR_TRUNCATED,        // json还没有结束输入就已经到达末尾
+        ERROR_DEPTH_EXCEEDED,   // 嵌套深度超出parse_limits::max_depth
+        ERROR_LIMIT_EXCEEDED,   // 超出parse_limits中的其他限制
+        ERROR_IO,               // 无法打开或读取文件
+        ERROR_SCHEMA            // 不符合JsonSchema，parse_error::expected为违反的关键字，比如"maxLength"
+    };
+
+    // 解析出错时的详细信息
+    struct parse_error
+    {
+        error_code code = ERROR_NONE;
+        ulong offset = 0;           // 出错位置相对于json开头的字节偏移
+        ulong line = 0;             // 出错位置的行号，从1开始
+        ulong column = 0;           // 出错位置的列号，从1开始，按utf-8字符计数
+        const char *expected = "";  // 出错位置期望出现的内容，比如"':'"
+    };
+
+    // 输出缓存中的文本以及生成它时使用的缩进
+    struct output_text
+    {
+        long indent;
+        string text;
+    };
+
+    // 缓存的输出文本，空指针表示没有缓存，拷贝文档时共享同一份文本
+    // 只读的节点可能被一个线程生成缓存的同时被另一个线程拷贝，因此拷贝时同样通过atomic_load读取
+    struct text_cache
+    {
+        text_cache() = default;
+        text_cache(const text_cache &other) : text(atomic_load(&other.text)) {}
+        text_cache &operator=(const text_cache &other)
+        {
+            atomic_store(&text, atomic_load(&other.text));
+            return *this;
+        }
+
+        shared_ptr<const output_text> text;
+    };
+
+    // 缓存的哈希值，0表示还没有计算，拷贝文档时一起拷贝
+    // 只读的节点可能被多个线程同时计算哈希值，因此使用atomic
+    struct hash_cache
+    {
+        hash_cache() = default;
+        hash_cache(const hash_cache &other) : value(other.value.load(memory_order_relaxed)) {}
+        hash_cache &operator=(const hash_cache &other)
+        {
+            value.store(other.value.load(memory_order_relaxed), memory_order_relaxed);
+            return *this;
+        }
+
+        atomic<uint64_t> value{0};
     };
 
+    // 拷贝时复制这一层的键和字符串、数字等值（代价与这一层的大小成正比），子对象和子数组只复制指针，在多个拷贝之间共享
     class JsonObject
     {
     public:
@@ -48,21 +193,115 @@ namespace Shanhj_Json
         void insert(const string &key, const JsonObject &value);
         void insert(const string &key, const JsonArray &value);
 
-        bool get_string(const string &key, string &result);
-        bool get_boolean(const string &key, bool &result);
-        bool get_int(const string &key, int64_t &result);
-        bool get_double(const string &key, double &result);
-        bool get_object(const string &key, JsonObject &result);
-        bool get_array(const string &key, JsonArray &result);
+        // 读取函数和output_to_string都不修改文档，没有写入时可以被多个线程同时调用
+        bool get_string(const string &key, string &result) const;
+        bool get_boolean(const string &key, bool &result) const;
+        bool get_int(const string &key, int64_t &result) const;
+        bool get_double(const string &key, double &result) const;
+        bool get_object(const string &key, JsonObject &result) const;
+        bool get_array(const string &key, JsonArray &result) const;
+        // 获取键为key的值的引用，不复制，不存在该键值时返回false
+        bool get_value(const string &key, JsonValue &result) const;
+
+        // 按键的顺序遍历成员的只读迭代器，解引用得到键和值的引用，不复制也不分配内存
+        // 对象被修改后迭代器失效，用法：for (auto [key, value] : obj)
+        // 解引用得到的是临时的pair而不是引用，没有operator->
+        class const_iterator
+        {
+        public:
+            typedef forward_iterator_tag iterator_category;
+            typedef pair<const string &, JsonValue> value_type;
+            typedef ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef pair<const string &, JsonValue> reference;
+
+            reference operator*() const;
+            const_iterator &operator++();
+            const_iterator operator++(int);
+            bool operator==(const const_iterator &other) const;
+            bool operator!=(const const_iterator &other) const;
+
+        private:
+            friend class JsonObject;
+            const_iterator(const JsonObject *owner, map<string, pair<Shanhj_Json::value_type, ulong>>::const_iterator iter);
+
+            const JsonObject *owner;
+            map<string, pair<Shanhj_Json::value_type, ulong>>::const_iterator iter;
+        };
+        const_iterator begin() const;
+        const_iterator end() const;
+        // 按深度优先的顺序访问当前对象及其中的所有值，不复制也不分配内存
+        void visit(JsonVisitor &visitor) const;
+
+        // 移除键值为key的元素，不存在该键值时返回false
+        bool remove(const string &key);
         // 清空所有值
         void clear();
 
+        // 按顺序执行RFC 6902 JSON Patch中的操作，直接修改当前对象，只访问patch中路径经过的节点
+        // 任何一个操作失败时返回false，此前已经执行的操作全部撤销，对象保持执行前的内容
+        bool apply_patch(const JsonArray &patch);
+        // 按RFC 7386 Merge Patch合并patch，值为null的键会被移除，直接修改当前对象
+        void apply_merge_patch(const JsonObject &patch);
+
         // 默认有4个空格的缩进，如果传入的indent<0则无缩进
-        string output_to_string(long indent = 0);
+        string output_to_string(long indent = 0) const;
+        // 用threads个线程输出，结果与output_to_string完全相同，threads为0时使用硬件支持的线程数
+        // 较大的子树会被拆开，连续的若干个成员作为一个任务写入各自的缓冲区，最后按顺序拼接
+        // 输出期间不能修改文档，文档较小时直接在当前线程输出
+        string output_parallel(long indent = 0, ulong threads = 0) const;
+        // 开启后output_to_string会缓存每一层对象和数组输出的文本，只有被修改过的部分需要重新生成
+        // insert、remove、clear等修改会使所在的对象或数组以及它的上层的缓存失效，关闭时释放所有缓存
+        void set_output_cache(bool enable);
+        // 按结构计算哈希值，与键的顺序无关，整数和值相等的浮点数哈希值相同
+        // 每一层对象和数组的哈希值会被缓存，修改后只重新计算被修改的那一层，未修改的子树直接使用缓存
+        uint64_t hash() const;
+        // 按内容比较，整数和浮点数按数值比较，两边的哈希值都已缓存并且不同时直接返回false
+        bool operator==(const JsonObject &other) const;
+        bool operator!=(const JsonObject &other) const;
+        // 生成不可修改的冻结副本，所有值连续存放在一块内存中，每个对象按键建立最小完美哈希
+        FrozenJson freeze() const;
         // 从字符串数组中构造json对象，返回构造结束时的指针位置，result存储构造结果，为false则表示解析出错
-        char *parser_from_array(char *array_begin, char *array_end, bool &result);
+        // 超出limits中的限制同样视为出错，返回的指针指向超出限制的位置
+        char *parser_from_array(char *array_begin, char *array_end, bool &result,
+                                const parse_limits &limits = parse_limits());
+        // 同上，出错时error中存储错误码、偏移量、行列号和期望出现的内容
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const parse_limits &limits = parse_limits());
+        // 同上，解析的同时按schema校验，出现不符合的值时立即停止，错误码为ERROR_SCHEMA
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const JsonSchema &schema, const parse_limits &limits = parse_limits());
+        // 同上，只构造projection选中的成员，其他成员只做语法校验然后跳过
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const JsonProjection &projection, const parse_limits &limits = parse_limits());
 
     private:
+        friend class JsonArray;
+        friend class Parser;
+        friend class JsonPatch;
+        friend class JsonSchema;
+        friend class FrozenJson;
+        friend class ParallelOutput;
+        friend class JsonValue;
+
+        // 将json文本追加到result末尾，cached为true时子对象和子数组使用并更新各自的缓存
+        void output(string &result, long indent, bool cached) const;
+        typedef map<string, pair<value_type, ulong>>::const_iterator member_iterator;
+        // 输出的各个部分，output依次调用它们，ParallelOutput把成员分成多段交给不同的线程输出后再拼接
+        void output_begin(string &result, long indent) const;
+        void output_end(string &result, long indent) const;
+        // 输出一个成员的键以及它之前的分隔符和缩进，first表示是对象的第一个成员
+        static void output_key(string &result, const string &key, bool first, long indent);
+        // 输出[begin, end)中的成员，first表示begin是对象的第一个成员
+        void output_members(string &result, member_iterator begin, member_iterator end, bool first, long indent,
+                            bool cached) const;
+        // 返回缓存的json文本，缓存失效或者缩进不同时重新生成
+        shared_ptr<const output_text> cached_output(long indent) const;
+        // 递归释放当前及所有下层的缓存
+        void drop_cache();
+        // 内容被修改，使输出缓存和哈希值失效
+        void modified();
+
         // 记录键值为key的元素在哪个vector中的什么位置
         // 如果是bool类型，则pair的第二个值记录true(1)或false(0)
         // 如果是null，则pair的第二个值忽略
@@ -70,10 +309,19 @@ namespace Shanhj_Json
         vector<string> v_string;
         vector<int64_t> v_int;
         vector<double> v_double;
-        vector<JsonObject> v_object;
-        vector<JsonArray> v_array;
+        vector<raw_number> v_number;
+        string number_text; // 保留原文的数字依次相连，不需要为每个数字分配内存
+        vector<shared_ptr<JsonObject>> v_object; // 子对象和子数组可以被多个文档共享，修改前需要先unshare
+        vector<shared_ptr<JsonArray>> v_array;
+
+        bool output_cache = false; // 是否开启了输出缓存
+        // 缓存的文本，修改时置空。生成后不再修改，拷贝文档时共享同一份
+        // 只读的节点可能被多个线程同时读取、拷贝和生成缓存，因此只通过atomic_load/atomic_store访问
+        mutable text_cache cache;
+        mutable hash_cache hash_value; // 缓存的哈希值，修改时置0
     };
 
+    // 拷贝时复制这一层的字符串、数字等值，压缩形式的数组复制全部元素（代价与这一层的大小成正比），子对象和子数组只复制指针，在多个拷贝之间共享
     class JsonArray
     {
     public:
@@ -86,1103 +334,6311 @@ namespace Shanhj_Json
         void insert(const JsonObject &value);
         void insert(const JsonArray &value);
 
-        bool get_string(ulong index, string &result);
-        bool get_boolean(ulong index, bool &result);
-        bool get_int(ulong index, int64_t &result);
-        bool get_double(ulong index, double &result);
-        bool get_object(ulong index, JsonObject &result);
-        bool get_array(ulong index, JsonArray &result);
+        // 读取函数和output_to_string都不修改文档，没有写入时可以被多个线程同时调用
+        bool get_string(ulong index, string &result) const;
+        bool get_boolean(ulong index, bool &result) const;
+        bool get_int(ulong index, int64_t &result) const;
+        bool get_double(ulong index, double &result) const;
+        bool get_object(ulong index, JsonObject &result) const;
+        bool get_array(ulong index, JsonArray &result) const;
+        // 获取第index个元素的引用，不复制，下标越界时返回false，压缩形式的数组按下标直接定位
+        bool get_value(ulong index, JsonValue &result) const;
+
+        // 按顺序遍历元素的只读迭代器，解引用得到元素的引用，不复制也不分配内存
+        // 数组被修改后迭代器失效，用法：for (auto value : arr)
+        // 解引用得到的是临时的JsonValue而不是引用，没有operator->
+        class const_iterator
+        {
+        public:
+            typedef forward_iterator_tag iterator_category;
+            typedef JsonValue value_type;
+            typedef ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef JsonValue reference;
+
+            reference operator*() const;
+            const_iterator &operator++();
+            const_iterator operator++(int);
+            bool operator==(const const_iterator &other) const;
+            bool operator!=(const const_iterator &other) const;
+
+        private:
+            friend class JsonArray;
+            const_iterator(const JsonArray *owner, ulong index, list<pair<Shanhj_Json::value_type, ulong>>::const_iterator iter);
+
+            const JsonArray *owner;
+            ulong index; // 压缩形式的数组按下标遍历，同时用来比较两个迭代器
+            list<pair<Shanhj_Json::value_type, ulong>>::const_iterator iter; // 普通形式的数组按position遍历
+        };
+        const_iterator begin() const;
+        const_iterator end() const;
+        // 按深度优先的顺序访问当前数组及其中的所有值，不复制也不分配内存
+        void visit(JsonVisitor &visitor) const;
+
         // 清空所有值
         void clear();
         // 默认有4个空格的缩进，如果传入的indent<0则无缩进
-        string output_to_string(long indent = 0);
+        string output_to_string(long indent = 0) const;
+        // 用threads个线程输出，结果与output_to_string完全相同，threads为0时使用硬件支持的线程数
+        // 较大的子树会被拆开，连续的若干个成员作为一个任务写入各自的缓冲区，最后按顺序拼接
+        // 输出期间不能修改文档，文档较小时直接在当前线程输出
+        string output_parallel(long indent = 0, ulong threads = 0) const;
+        // 开启后output_to_string会缓存每一层对象和数组输出的文本，只有被修改过的部分需要重新生成
+        // insert、remove、clear等修改会使所在的对象或数组以及它的上层的缓存失效，关闭时释放所有缓存
+        void set_output_cache(bool enable);
+        // 按结构计算哈希值，数组中元素的顺序影响结果，每一层的哈希值会被缓存，含义与JsonObject::hash相同
+        uint64_t hash() const;
+        // 按内容比较，含义与JsonObject::operator==相同
+        bool operator==(const JsonArray &other) const;
+        bool operator!=(const JsonArray &other) const;
+        // 生成不可修改的冻结副本，含义与JsonObject::freeze相同
+        FrozenJson freeze() const;
         // 从字符串数组中构造json数组，返回构造结束时的指针位置，result存储构造结果，为false则表示解析出错
-        char *parser_from_array(char *array_begin, char *array_end, bool &result);
+        // 超出limits中的限制同样视为出错，返回的指针指向超出限制的位置
+        char *parser_from_array(char *array_begin, char *array_end, bool &result,
+                                const parse_limits &limits = parse_limits());
+        // 同上，出错时error中存储错误码、偏移量、行列号和期望出现的内容
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const parse_limits &limits = parse_limits());
+        // 同上，解析的同时按schema校验，出现不符合的值时立即停止，错误码为ERROR_SCHEMA
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const JsonSchema &schema, const parse_limits &limits = parse_limits());
+        // 同上，只构造projection选中的成员，其他成员只做语法校验然后跳过
+        char *parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                const JsonProjection &projection, const parse_limits &limits = parse_limits());
         // 获取元素个数
-        ulong size();
+        ulong size() const;
         // 移除第index个元素，移除后index之后的元素下标减1
         bool remove(ulong index);
+        // 按顺序执行RFC 6902 JSON Patch中的操作，直接修改当前数组，只访问patch中路径经过的节点
+        // 任何一个操作失败时返回false，此前已经执行的操作全部撤销，数组保持执行前的内容
+        bool apply_patch(const JsonArray &patch);
+        // 把每个元素（对象）中与columns同名的字段按行提取到各列中，columns中原有的数据会被清空
+        // 元素不是对象、缺少该字段或者类型不符时该行无效
+        void extract(vector<JsonColumn> &columns) const;
+        // 元素全部是整数（或者数组为空）时，不拷贝地返回连续存放的所有元素，否则返回false
+        // 数组中出现过其他类型的元素后会转换为普通形式，即使再移除这些元素也返回false，clear或assign后重新压缩
+        bool get_ints(typed_span<int64_t> &result) const;
+        // 元素全部是数字（或者数组为空）时，不拷贝地返回转换为浮点数的所有元素，否则返回false
+        // 整数和浮点数混合时整数也按浮点数返回，绝对值超过2^53的整数不能精确转换，这样的数组返回false
+        // 与get_ints相同，只对一直保持压缩形式的数组成功
+        bool get_doubles(typed_span<double> &result) const;
+        // 用values替换数组中的所有元素
+        void assign(typed_span<int64_t> values);
+        void assign(typed_span<double> values);
 
     private:
+        friend class JsonObject;
+        friend class Parser;
+        friend class JsonPatch;
+        friend class JsonSchema;
+        friend class FrozenJson;
+        friend class ParallelOutput;
+        friend class JsonValue;
+
+        // 将json文本追加到result末尾，cached为true时子对象和子数组使用并更新各自的缓存
+        void output(string &result, long indent, bool cached) const;
+        typedef list<pair<value_type, ulong>>::const_iterator element_iterator;
+        // 输出的各个部分，含义与JsonObject相同
+        void output_begin(string &result, long indent) const;
+        void output_end(string &result, long indent) const;
+        // 输出一个元素之前的分隔符和缩进，first表示是数组的第一个元素
+        static void output_separator(string &result, bool first, long indent);
+        // 输出普通形式的数组中[begin, end)的元素，first表示begin是数组的第一个元素
+        void output_elements(string &result, element_iterator begin, element_iterator end, bool first, long indent,
+                             bool cached) const;
+        // 返回缓存的json文本，缓存失效或者缩进不同时重新生成
+        shared_ptr<const output_text> cached_output(long indent) const;
+        // 递归释放当前及所有下层的缓存
+        void drop_cache();
+        // 内容被修改，使输出缓存和哈希值失效
+        void modified();
+        // 在末尾添加一个type类型的元素之前调用，数组为空或者元素类型都与type相同时保持压缩形式并返回true，
+        // 否则先转换为普通形式并返回false，由调用者写入position，value只在布尔类型时使用，为true(1)或false(0)
+        // 返回后调用者仍需把值存入对应的vector
+        bool append_packed(value_type type, ulong value);
+        // 在末尾添加一个整数或浮点数，能保持压缩形式时直接写入并返回true，否则先转换为普通形式并返回false，由调用者写入
+        // 浮点数组中可以放入整数，整数组中放入浮点数时整体转换为浮点数组，超出2^53的整数不能精确转换，不压缩
+        bool append_number(int64_t int_value, double double_value, bool is_double);
+        // 从压缩形式转换为普通形式
+        void unpack();
+        // 第index个元素的类型和位置，含义与position中的元素相同，index必须小于size()
+        pair<value_type, ulong> entry_at(ulong index) const;
+        // 按顺序对每个元素的类型和位置调用f，压缩形式由下标生成
+        template <typename F>
+        void for_each_entry(F f) const;
+        // 按顺序返回所有元素的类型和位置
+        vector<pair<value_type, ulong>> entries() const;
+        // 输出压缩形式的数组中下标在[begin, end)的元素，first的含义与output_elements相同
+        void output_packed(string &result, ulong begin, ulong end, bool first, long indent) const;
+
         // 记录下标为index的元素是什么类型，以及在vector中的下标
         // 如果是bool类型，则第二个值记录true(1)或false(0)
         // 如果是null，则第二个值忽略
         list<pair<value_type, ulong>> position;
+        // 元素类型都相同的数组使用压缩形式：position为空，第i个元素就是对应vector中的第i个值
+        // 可以压缩的类型为TYPE_STRING、TYPE_INT、TYPE_DOUBLE和TYPE_BOOLEAN，TYPE_NULL表示普通形式
+        value_type packed = TYPE_NULL;
+        vector<uint8_t> v_boolean; // 压缩形式的布尔数组
+        // 压缩形式的浮点数组中含有整数时，int_mark[i]为1表示第i个元素是整数，值同时存放在v_int[i]中，输出和读取时仍是整数
+        // int_mark为空时没有整数，此时v_int也为空，否则两者都与v_double一样长
+        vector<uint8_t> int_mark;
         vector<string> v_string;
         vector<int64_t> v_int;
         vector<double> v_double;
-        vector<JsonObject> v_object;
-        vector<JsonArray> v_array;
+        vector<raw_number> v_number;
+        string number_text; // 保留原文的数字依次相连，不需要为每个数字分配内存
+        vector<shared_ptr<JsonObject>> v_object; // 子对象和子数组可以被多个文档共享，修改前需要先unshare
+        vector<shared_ptr<JsonArray>> v_array;
+
+        bool output_cache = false; // 是否开启了输出缓存
+        // 缓存的文本，修改时置空。生成后不再修改，拷贝文档时共享同一份
+        // 只读的节点可能被多个线程同时读取、拷贝和生成缓存，因此只通过atomic_load/atomic_store访问
+        mutable text_cache cache;
+        mutable hash_cache hash_value; // 缓存的哈希值，修改时置0
     };
-    // 跳过空格和换行符，如果array到达array_end则返回false
-    inline bool skip_space(char *&array, char *array_end);
 
-    // 通过第一个字节的内容返回非ascii字符的utf-8编码的长度
-    // 如果是ascii编码，则返回0
-    inline uint8_t get_utf8_len(char first_c);
+    // JsonObject/JsonArray中一个值的引用，只保存所在容器的指针和值的位置，本身不拥有数据
+    // 读取函数的含义与JsonObject/JsonArray相同，不能在所在的容器被修改或销毁后使用
+    class JsonValue
+    {
+    public:
+        // 默认构造的值为null，用来接收get_value的结果
+        JsonValue() = default;
 
-    // 返回出错位置的行和列
-    // begin为json序列开始的位置
-    string error_position(char *begin, char *error_pos);
+        value_type type() const;
+        // 字符串直接引用容器中保存的内容，不需要拷贝
+        bool get_string(string_view &result) const;
+        bool get_boolean(bool &result) const;
+        bool get_int(int64_t &result) const;
+        bool get_double(double &result) const;
+        // 子对象和子数组返回指向文档中原有节点的指针，不复制
+        bool get_object(const JsonObject *&result) const;
+        bool get_array(const JsonArray *&result) const;
+        // 按深度优先的顺序访问这个值，子对象和子数组会访问其中的所有值
+        void visit(JsonVisitor &visitor) const;
 
-    // 从带有转义字符的文本中获取一个二进制字符串，遇到 " 停止，如果合法返回true
-    // 自动处理转义字符，结束后array将指向 " 的后一个位置
-    bool get_binary_from_text(char *&array, char *array_end, string &result);
+    private:
+        friend class JsonObject;
+        friend class JsonArray;
 
-    // 将二进制字符串转成文本，特殊字符进行转义
-    // 如果转换的内容不是utf-8格式，返回空字符串
-    string binary_to_text(const string &binary);
-}
+        JsonValue(const JsonObject *object, const JsonArray *array, pair<value_type, ulong> entry);
 
-bool Shanhj_Json::skip_space(char *&array, char *array_end)
-{
-    while (array < array_end && (*array == ' ' || *array == '\n'))
-        array++;
-    return array < array_end;
-}
+        // 所在的容器，object和array有且只有一个不为空，默认构造时都为空
+        const JsonObject *object = nullptr;
+        const JsonArray *array = nullptr;
+        pair<value_type, ulong> entry = {TYPE_NULL, 0};
+    };
 
-uint8_t Shanhj_Json::get_utf8_len(char first_c)
-{
-    uint8_t len = 0;
-    while (first_c & 0x80)
+    // 深度优先遍历文档的访问者，通过JsonObject/JsonArray/JsonValue::visit使用，只需要重写关心的函数
+    // 字符串和容器都以引用的形式传入，遍历本身不复制也不分配内存，遍历期间不能修改文档
+    class JsonVisitor
     {
-        len++;
-        first_c <<= 1;
-    }
-    return len;
-}
+    public:
+        virtual ~JsonVisitor() = default;
 
-std::string Shanhj_Json::error_position(char *begin, char *error_pos)
-{
-    ulong line = 1, column = 0;
-    while (begin <= error_pos)
+        // 对象中的每个值之前调用key，数组中的每个元素之前调用index
+        virtual void key(const string &) {}
+        virtual void index(ulong) {}
+        // 进入对象或数组时调用，返回false时跳过其中的所有值，之后仍会调用对应的end函数
+        virtual bool object_begin(const JsonObject &) { return true; }
+        virtual void object_end(const JsonObject &) {}
+        virtual bool array_begin(const JsonArray &) { return true; }
+        virtual void array_end(const JsonArray &) {}
+        virtual void string_value(const string &) {}
+        virtual void int_value(int64_t) {}
+        virtual void double_value(double) {}
+        virtual void boolean_value(bool) {}
+        virtual void null_value() {}
+        // 保留原文的数字，默认按JsonValue::get_int/get_double转换后调用int_value或double_value
+        virtual void number_value(const JsonValue &value);
+    };
+
+    // 输入末尾额外保留的0字节数，解析带填充的输入时可以越过末尾读取最多这么多字节而不检查边界
+    const ulong input_padding = 64;
+
+    // 末尾带有input_padding个0字节的输入缓冲区，交给Parser::parse时走不检查边界的快速路径
+    // 填充部分不属于json的内容，size不包括填充部分
+    class PaddedBuffer
     {
-        auto len = get_utf8_len(*begin);
-        if (len == -1)
-        {
-            return "not utf-8 text";
-        }
-        else if (len == 0) // ASCII码
+    public:
+        PaddedBuffer() = default;
+        // 分配size个字节，内容未初始化
+        explicit PaddedBuffer(ulong size);
+        // 复制[data, data + size)
+        PaddedBuffer(const char *data, ulong size);
+        explicit PaddedBuffer(const string &text);
+
+        // 读入path指向的整个文件，失败时返回false并清空缓冲区
+        bool load(const string &path);
+        char *data();
+        const char *data() const;
+        ulong size() const;
+
+    private:
+        unique_ptr<char[]> buffer;
+        ulong length = 0;
+    };
+
+    // 非递归的json解析器，用显式的栈代替函数之间的递归调用，嵌套再深也不会耗尽线程栈
+    // 子对象和子数组直接在父容器中原地构造，不再产生临时对象和逐层拷贝
+    // 栈、临时缓冲区和回收的节点在多次解析之间复用，反复解析结构相似的json时几乎不需要分配内存
+    // 同一个Parser可以反复使用，但不能被多个线程同时使用
+    class Parser
+    {
+    public:
+        Parser() = default;
+        explicit Parser(const parse_limits &limits);
+
+        // 解析json对象，返回值和result的含义与JsonObject::parser_from_array相同
+        char *parse(char *array_begin, char *array_end, JsonObject &target, bool &result);
+        // 解析json数组，返回值和result的含义与JsonArray::parser_from_array相同
+        char *parse(char *array_begin, char *array_end, JsonArray &target, bool &result);
+        // 解析带填充的输入，依靠末尾的0字节结束扫描，不再逐字符检查是否到达末尾，字面量按整字比较
+        // 返回值指向input中的位置，其他行为与上面相同
+        char *parse(PaddedBuffer &input, JsonObject &target, bool &result);
+        char *parse(PaddedBuffer &input, JsonArray &target, bool &result);
+        // 不构造JsonObject/JsonArray，校验json对象或数组的同时直接输出到output末尾
+        // 键的顺序、字符串和数字的原文保持不变，indent的含义与output_to_string相同
+        // 除了记录嵌套层次的栈以外只需要常数的内存，返回值和result的含义与parse相同
+        // 出错时output恢复为调用前的内容，不会留下输出了一半的文本
+        char *transcode(char *array_begin, char *array_end, string &output, bool &result, long indent = 0);
+        // 解析元素为对象的json数组，不构造JsonObject/JsonArray，直接把columns中各列对应的字段按行提取出来
+        // 其他字段和嵌套的值只做校验然后跳过，columns中原有的数据会被清空，返回值和result的含义与parse相同
+        char *extract(char *array_begin, char *array_end, vector<JsonColumn> &columns, bool &result);
+        // 最近一次解析的错误信息，解析成功时code为ERROR_NONE
+        const parse_error &last_error() const;
+        // 清空target，将其中的子对象、子数组、字符串和键值节点回收到池中，供之后的解析使用
+        // 与其他文档共享的子树不会被回收，parse在解析前会自动回收target原来的内容
+        void recycle(JsonObject &target);
+        void recycle(JsonArray &target);
+        // 释放池中的所有节点
+        void release_pools();
+
+        parse_limits limits;
+        // 为true时数字只保存原文和分类，get_int/get_double时才转换，输出时原样写回
+        // 在int64_t范围内的整数只能用get_int读取，其他数字只能用get_double读取，与默认模式相同
+        bool raw_numbers = false;
+        // 不为空时parse在解析的同时按schema校验，出现不符合的值时立即停止，不需要再遍历一遍文档
+        const JsonSchema *schema = nullptr;
+        // 不为空时parse只构造projection选中的成员，其他成员只做语法校验然后跳过，不构造任何值
+        // 同时设置了schema时，跳过的成员同样按schema校验，不符合时解析失败
+        const JsonProjection *projection = nullptr;
+
+    private:
+        // 正在解析的容器，构造文档时object和array中对应的一个指向正在构造的容器，不构造时都为空
+        struct frame
         {
-            if (*begin == '\n')
-            {
-                line++;
-                column = 0;
-            }
-            else
-                column++;
-            begin++;
-        }
-        else // 非ASCII码
+            bool is_object;
+            JsonObject *object = nullptr;
+            JsonArray *array = nullptr;
+            bool keep = true;      // 是否构造容器中的值，投影没有选中的成员中为false
+            ulong value_order = 0; // 已经解析出的值的个数
+            long schema = -1;      // 容器对应的schema节点，-1表示不需要校验
+            uint64_t seen = 0;     // 已经出现的required键
+            long mask = -1;        // 容器对应的投影节点，-1表示构造所有成员
+        };
+
+        // tokenize读到的键和值交给Sink处理，parse、transcode和extract分别使用以下三种Sink
+        // keep为false的值只校验不构造，string_target返回空指针时字符串只校验转义字符，不保存内容
+        // 构造JsonObject/JsonArray
+        struct build_sink
         {
-            column++;
-            begin += len;
-        }
-    }
-    return "lines:" + to_string(line) + ",colum:" + to_string(column);
-}
+            Parser &parser;
+            string value{}; // 正在解析的字符串
 
-bool Shanhj_Json::get_binary_from_text(char *&array, char *array_end, string &result)
-{
-    if (array >= array_end) return false;
-    while (*array != '\"')
-    {
-        auto len = get_utf8_len(*array);
-        if (len == -1)
-            return false;
-        else if (len == 0) // ASCII码
+            bool wants_key(const frame &top) const;
+            void member(const frame &top);
+            void key(const frame &top, const char *begin, const char *end);
+            string *string_target(const frame &top, bool keep, long rule);
+            void string_value(frame &top, bool keep, const char *begin, const char *end);
+            void literal(frame &top, bool keep, value_type type, bool value, const char *begin, ulong length);
+            template <bool padded>
+            bool number(frame &top, bool keep, char *&array, char *array_end);
+            void open(frame &top, frame &child);
+            void close(const frame &top);
+        };
+        // 按原文输出，键、字符串和数字都不转换
+        struct text_sink
         {
-            if (*array == '\\') // 转义字符
-            {
-                array++;
-                if (array >= array_end) return false;
-                switch (*array)
-                {
-                case 'n':
-                    result += '\n';
-                    break;
-                case '\"':
-                    result += '\"';
-                    break;
-                case '\\':
-                    result += '\\';
-                    break;
-                case 'b':
-                    result += '\b';
-                    break;
-                case 'f':
-                    result += '\f';
-                    break;
-                case 't':
-                    result += '\t';
-                    break;
-                case 'r':
-                    result += '\r';
-                    break;
-                case '/':
-                    result += '/';
-                    break;
-                default: // 不合法的转义字符
-                    return false;
-                    break;
-                }
-            }
-            else
-                result += *array;
-        }
-        else // 非ASCII码
+            Parser &parser;
+            string &output;
+            long indent;
+
+            bool wants_key(const frame &top) const;
+            void member(const frame &top);
+            void key(const frame &top, const char *begin, const char *end);
+            string *string_target(const frame &top, bool keep, long rule);
+            void string_value(frame &top, bool keep, const char *begin, const char *end);
+            void literal(frame &top, bool keep, value_type type, bool value, const char *begin, ulong length);
+            template <bool padded>
+            bool number(frame &top, bool keep, char *&array, char *array_end);
+            void open(frame &top, frame &child);
+            void close(const frame &top);
+        };
+        // 把数组元素的字段存入对应的列
+        struct column_sink
         {
-            while (array < array_end && --len)
-            {
-                result += *array;
-                array++;
-            }
-            result += *array;
-        }
-        array++;
-        if (array >= array_end) return false;
-    }
-    array++;
-    return true;
-}
+            Parser &parser;
+            vector<JsonColumn> &columns;
+            JsonColumn *field = nullptr;   // 刚读到的键对应的列，只有数组元素本身的字段才可能属于某一列
+            JsonColumn *current = nullptr; // 正在解析的字符串所属的列
 
-std::string Shanhj_Json::binary_to_text(const string &binary)
-{
-    string result;
-    for (int i = 0; i < binary.size(); i++)
+            bool wants_key(const frame &top) const;
+            void member(const frame &top);
+            void key(const frame &top, const char *begin, const char *end);
+            string *string_target(const frame &top, bool keep, long rule);
+            void string_value(frame &top, bool keep, const char *begin, const char *end);
+            void literal(frame &top, bool keep, value_type type, bool value, const char *begin, ulong length);
+            template <bool padded>
+            bool number(frame &top, bool keep, char *&array, char *array_end);
+            void open(frame &top, frame &child);
+            void close(const frame &top);
+            // 取出下一个值所属的列，不属于任何列时返回空指针
+            JsonColumn *take_field();
+        };
+
+        // 检查文档开头，open为'{'、'['或者0（两者都可以），成功时array_begin指向开头的括号
+        // 出错时返回false，array_begin指向出错位置
+        bool open_document(char *&array_begin, char *array_end, char open, bool &result);
+        // 检查文档开头并将root入栈，然后开始解析，padded表示输入末尾是否有input_padding个0字节
+        template <bool padded>
+        char *parse_root(char *array_begin, char *array_end, frame root, bool &result);
+        // parse、transcode和extract共用的语法分析，从栈顶的容器开始按json的语法逐个读取键和值，直到栈底的容器结束
+        // 嵌套层次、值的个数、字符串长度和schema都在这里检查，读到的内容交给sink处理
+        template <bool padded, typename Sink>
+        char *tokenize(char *array_begin, char *array_end, Sink &sink, bool &result);
+        // 记录错误信息并返回出错位置，只在出错时计算行列号
+        char *fail(char *position, error_code code, const char *expected, bool &result);
+        // 按json的语法跳过一个数字并返回它的分类
+        template <bool padded = false>
+        static bool classify_number(char *&array, char *array_end, number_kind &kind);
+        // 解析一个数字，整数存入int_value，浮点数存入double_value，is_double表示是哪一种
+        // 超出int64_t范围的整数按浮点数处理
+        template <bool padded = false>
+        bool parse_number(char *&array, char *array_end, int64_t &int_value, double &double_value, bool &is_double);
+        // 在top对应的容器中为下一个值占一个位置并返回，如果是对象则键值为key，优先使用池中的节点
+        pair<value_type, ulong> &next_slot(frame &top);
+        // 在值存入对应的vector之前记录下一个值的类型和位置，数组的元素类型都相同时保持压缩形式，不占用节点
+        void add_slot(frame &top, value_type type, ulong index);
+        // 从池中取出一个字符串、对象或数组，池为空时新建
+        string take_string();
+        template <typename T>
+        shared_ptr<T> take_node(vector<shared_ptr<T>> &pool);
+        // 回收以root为根的所有节点
+        void recycle_nodes(frame root);
+        // 回收容器中的字符串和只属于该容器的子节点，子节点入栈等待继续回收
+        template <typename Container>
+        void recycle_storage(Container &container);
+
+        vector<frame> stack;
+        ulong node_count = 0;
+        char *document_begin = nullptr;
+        char *document_end = nullptr;
+        parse_error error;
+        string key;
+        string num;
+
+        // 回收的节点池
+        vector<shared_ptr<JsonObject>> object_pool;
+        vector<shared_ptr<JsonArray>> array_pool;
+        vector<string> string_pool;
+        vector<map<string, pair<value_type, ulong>>::node_type> key_pool;
+        list<pair<value_type, ulong>> entry_pool;
+    };
+
+    // JSON Patch（RFC 6902）和Merge Patch（RFC 7386）的实现，通过JsonObject/JsonArray的成员函数使用
+    // 路径使用JSON Pointer（RFC 6901）表示，比如"/a/0/b"，键中的'~'和'/'分别写作"~0"和"~1"
+    class JsonPatch
     {
-        auto len = get_utf8_len(binary[i]);
-        if (len == 0) // ASCII字符
+    public:
+        // 生成把a变成b的JSON Patch，只包含两者不同的部分
+        // 数组按最长公共子序列对齐，中间插入或删除的元素生成add和remove，而不是把后面的元素逐个替换
+        static JsonArray diff(const JsonObject &a, const JsonObject &b);
+        static JsonArray diff(const JsonArray &a, const JsonArray &b);
+
+    private:
+        friend class JsonObject;
+        friend class JsonArray;
+
+        typedef pair<value_type, ulong> entry;
+
+        // 路径中最后一级所在的容器，object和array有且只有一个不为空，token为最后一级的键或下标
+        struct location
         {
-            switch (binary[i])
-            {
-            case '\n':
-                result += "\\n";
-                break;
-            case '\r':
-                result += "\\r";
-                break;
-            case '\t':
-                result += "\\t";
-                break;
-            case '\f':
-                result += "\\f";
-                break;
-            case '\b':
-                result += "\\b";
-                break;
-            case '\\':
-                result += "\\\\";
-                break;
-            case '/':
-                result += "\\/";
-                break;
-            case '\"':
-                result += "\\\"";
-                break;
-            default:
-                result += binary[i];
-                break;
-            }
-        }
-        else // 非ASCII字符
+            JsonObject *object;
+            JsonArray *array;
+            string token;
+        };
+        // 同上，用于只读取而不修改文档的检查
+        struct const_location
         {
-            while (--len)
-            {
-                result += binary[i];
-                i++;
-            }
-            result += binary[i];
-        }
-    }
-    return result;
-}
+            const JsonObject *object;
+            const JsonArray *array;
+            string token;
+        };
+        // 路径指向的值及其所在的容器，用于只读取而不修改文档的操作
+        struct value_ref
+        {
+            const JsonObject *object;
+            const JsonArray *array;
+            entry value;
+        };
+        // 执行一个patch期间的修改记录，某个操作失败时按相反的顺序撤销此前所有的修改，整个patch不生效
+        // 被删除或替换的值仍然留在vector中，撤销时只需要恢复position，不再使用的位置之后由compact回收
+        struct journal
+        {
+            vector<function<void()>> undo;
+            list<entry> removed;                 // 从普通形式的数组中删除的元素，撤销时移回原来的位置
+            unordered_set<const void *> touched; // 本次patch已经修改过的容器
+        };
 
-void Shanhj_Json::JsonObject::insert(const string &key, const string &value)
-{
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_STRING)
-    {
-        v_string[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_STRING, v_string.size()};
-        v_string.push_back(value);
-    }
-}
+        // 执行patch中的操作，object和array有且只有一个不为空，表示被修改的文档，失败时文档不变
+        static bool apply(JsonObject *object, JsonArray *array, const JsonArray &patch);
+        // 执行一个操作，失败时返回false，已经做出的修改都记录在log中
+        static bool apply_op(JsonObject *object, JsonArray *array, const JsonObject &op, journal &log);
+        // 路径为空的add和replace，用op中的value替换整个文档
+        static bool replace_root(JsonObject *object, JsonArray *array, const JsonObject &op, const entry &value, journal &log);
+        static void merge(JsonObject &target, const JsonObject &patch);
 
-void Shanhj_Json::JsonObject::insert(const string &key, const char *value)
-{
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_STRING)
-    {
-        v_string[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_STRING, v_string.size()};
-        v_string.push_back(value);
-    }
-}
+        // 只读取地找到pointer中最后一级所在的容器，pointer为空（即整个文档）或者中间某一级不存在时返回false
+        static bool walk(const JsonObject *object, const JsonArray *array, const string &pointer, const_location &loc);
+        // loc.token能否作为目标，adding为true时是add的目标（对象中任意键，数组中不超过元素个数的下标或"-"），否则必须已经存在
+        static bool check_target(const const_location &loc, bool adding);
+        // 路径检查过之后找到最后一级所在的容器，经过的容器依次unshare并使缓存失效，压缩形式的数组保持不变
+        static void resolve(JsonObject *object, JsonArray *array, const string &pointer, location &loc, journal &log);
+        // 本次patch第一次修改容器之前调用：回收之前留下的不再使用的位置，使输出缓存和哈希值失效
+        template <typename C>
+        static void touch(C &c, journal &log);
+        // 与unshare相同，替换节点时记录在log中，撤销时换回原来的节点
+        template <typename T>
+        static T &unshare_slot(vector<shared_ptr<T>> &nodes, ulong index, journal &log);
+        // 找到pointer指向的值，不修改经过的容器，用于test和copy、move的源路径
+        static bool lookup(const JsonObject *object, const JsonArray *array, const string &pointer, value_ref &ref);
+        // 从pointer的begin位置读取一级并还原转义，begin移到下一级的开头，last表示是否为最后一级
+        static bool read_token(const string &pointer, size_t &begin, string &token, bool &last);
+        // 在容器中查找token对应的值，不存在时返回空指针
+        static entry *find(JsonObject *object, JsonArray *array, const string &token);
+        static bool find_value(const JsonObject *object, const JsonArray *array, const string &token, entry &value);
+        // 将token解析为数组下标，必须是没有前导0的十进制数并且小于limit
+        static bool parse_index(const string &token, ulong limit, ulong &index);
+        static list<entry>::iterator array_at(JsonArray &array, ulong index);
+        static string escape_token(const string &token);
 
-void Shanhj_Json::JsonObject::insert(const string &key, bool value)
-{
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_BOOLEAN)
-        position[key].second = value;
-    else
-        position[key] = {TYPE_BOOLEAN, value};
-}
+        // RFC 6902中的add、remove、replace操作，value为src中的值，目标已经用check_target检查过
+        // 压缩形式的数组中放入同类型的值时直接修改对应的vector，不转换为普通形式
+        template <typename Src>
+        static void add(const location &loc, Src &src, const entry &value, journal &log);
+        static void remove(const location &loc, journal &log);
+        template <typename Src>
+        static void replace(const location &loc, Src &src, const entry &value, journal &log);
+        // 在压缩形式的数组的第index个位置写入value，insert为true时插入，否则替换，类型不能放入时返回false
+        template <typename Src>
+        static bool put_packed(JsonArray &array, ulong index, bool insert, Src &src, const entry &value, journal &log);
+        static void erase_packed(JsonArray &array, ulong index, journal &log);
+        template <typename V, typename T>
+        static void put_slot(V &values, ulong index, bool insert, T value, journal &log);
+        template <typename V>
+        static void erase_slot(V &values, ulong index, journal &log);
+        // 转换为普通形式，撤销时恢复压缩形式
+        static void unpack(JsonArray &array, journal &log);
 
-void Shanhj_Json::JsonObject::insert(const string &key, int value)
-{
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_INT)
-    {
-        v_int[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_INT, v_int.size()};
-        v_int.push_back(value);
-    }
-}
+        // 将src中的值放入dst的vector中并返回新的位置，src为const时拷贝，否则移动
+        template <typename Dst, typename Src>
+        static entry store(Dst &dst, Src &src, const entry &value);
+        // 用src中的值替换dst中target指向的值，类型相同时直接覆盖原来的位置，否则放入新的位置
+        template <typename Dst, typename Src>
+        static void assign(Dst &dst, entry &target, Src &src, const entry &value);
+        // 不再使用的位置多于仍在使用的值时，按position重新排列各个vector，只保留仍在使用的值
+        static void compact(JsonObject &object);
+        static void compact(JsonArray &array);
+        template <typename C>
+        static void compact_storage(C &c);
+        static entry &entry_of(pair<const string, entry> &item);
+        static entry &entry_of(entry &item);
 
-void Shanhj_Json::JsonObject::insert(const string &key, int64_t value)
-{
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_INT)
+        // 比较两个值是否相等，整数和浮点数按数值比较
+        template <typename A, typename B>
+        static bool equal(const A &a, const entry &ea, const B &b, const entry &eb);
+        static bool equal(const JsonObject &a, const JsonObject &b);
+        static bool equal(const JsonArray &a, const JsonArray &b);
+        // 计算哈希值，对象中各个键值对的哈希值相加，因此与顺序无关
+        static uint64_t hash(const JsonObject &object);
+        static uint64_t hash(const JsonArray &array);
+        // 计算一个值的哈希值，所有数字都按浮点数计算，使数值相等的整数和浮点数哈希值相同
+        template <typename C>
+        static uint64_t hash(const C &c, const entry &value);
+        // 两个文档的哈希值都已缓存并且不同，即内容一定不同
+        template <typename T>
+        static bool hash_differs(const T &a, const T &b);
+        // 读取整数、浮点数或保留原文的数字，value不是数字时返回false
+        template <typename C>
+        static bool number_value(const C &c, const entry &value, int64_t &int_value, double &double_value, bool &is_double);
+
+        static void diff_object(const JsonObject &a, const JsonObject &b, const string &path, JsonArray &patch);
+        static void diff_array(const JsonArray &a, const JsonArray &b, const string &path, JsonArray &patch);
+        // 对齐数组时最多保存的状态个数，约为编辑距离的平方，超过时直接按下标对齐
+        static constexpr ulong align_limit = 1 << 20;
+        template <typename A, typename B>
+        static void diff_value(const A &a, const entry &ea, const B &b, const entry &eb, const string &path, JsonArray &patch);
+        // 向patch末尾添加一个操作，src不为空时带有value
+        template <typename Src>
+        static void emit(JsonArray &patch, const char *op, const string &path, const Src *src, const entry &value);
+    };
+    // JsonObject/JsonArray::output_parallel的实现
+    // 先统计每棵较大的子树中值的个数，再把文档按顺序切分成文本片段和输出任务，任务由多个线程并行执行
+    // 每个任务是某个容器中连续的一段成员，只有值的个数超过一个任务的子树才会被拆开，它的开头、结尾和键由当前线程写入
+    class ParallelOutput
+    {
+    public:
+        template <typename Root>
+        static string output(const Root &root, long indent, ulong threads);
+
+    private:
+        // 值的个数少于它的子树不记录个数，也不会被拆开
+        static constexpr ulong min_split = 4096;
+
+        struct planner
+        {
+            unordered_map<const void *, ulong> weights; // 较大的子树中值的个数（包括容器本身）
+            ulong target = 0;                             // 每个任务大约包含的值的个数
+            bool cached = false;                          // 任务是否使用并更新子树的输出缓存
+            vector<string> parts;                         // 按顺序排列的输出片段，任务对应的片段由任务填写
+            vector<pair<ulong, function<void(string &)>>> tasks; // 任务及其输出所在的片段
+            bool text_open = false;                       // parts中最后一个片段是否为当前线程写入的文本
+
+            // 返回可以继续追加文本的片段
+            string &text();
+            // 添加一个任务，它的输出占用一个新的片段
+            void add_task(function<void(string &)> task);
+        };
+
+        // 统计子树中值的个数
+        static ulong weigh(planner &p, const JsonObject &object);
+        static ulong weigh(planner &p, const JsonArray &array);
+        // 子树中值的个数，较小的子树只计算这一层，count为它的成员个数
+        static ulong weight_of(const planner &p, const void *container, ulong count);
+        // 把容器的输出切分到p中，indent的含义与output_to_string相同
+        static void plan(planner &p, const JsonObject &object, long indent);
+        static void plan(planner &p, const JsonArray &array, long indent);
+        // 用threads个线程执行所有任务，任务抛出的第一个异常在所有线程结束后重新抛出
+        static void run(planner &p, ulong threads);
+    };
+
+    // 列式提取的一列，按行保存数组中每个对象名为name的字段，数据连续存放，可以直接用于批量计算
+    // 缺少该字段、值为null或者类型不符的行记为无效，无效的行中的值为0或空字符串
+    class JsonColumn
+    {
+    public:
+        // type只能是TYPE_INT、TYPE_DOUBLE、TYPE_BOOLEAN或TYPE_STRING，TYPE_DOUBLE的列也接受整数
+        JsonColumn(const string &name, value_type type);
+
+        // 第row行是否有效
+        bool valid(ulong row) const;
+        // 第row行的字符串，只用于TYPE_STRING的列，返回的内容在下一次提取之前有效
+        string_view get_string(ulong row) const;
+
+        string name;
+        value_type type;
+        ulong rows = 0;            // 行数，即数组中元素的个数
+        vector<uint64_t> validity; // 有效位图，第row位为1表示第row行有效
+        vector<int64_t> ints;      // TYPE_INT列的值
+        vector<double> doubles;    // TYPE_DOUBLE列的值
+        vector<uint8_t> booleans;  // TYPE_BOOLEAN列的值
+        string chars;              // TYPE_STRING列每一行转义后的内容依次相连
+        vector<ulong> offsets;     // 第row行的字符串为chars中[offsets[row], offsets[row + 1])的部分
+
+    private:
+        friend class JsonArray;
+        friend class Parser;
+
+        // 清空所有行
+        void reset();
+        // 添加一个无效的行
+        void add_row();
+        // 设置最后一行是否有效，设为无效时同时清除该行的值
+        void mark(bool is_valid);
+    };
+
+    // JsonArrayReader读取的文件的格式
+    enum stream_format
+    {
+        STREAM_ARRAY,   // 一个json数组，逐个读取其中的元素
+        STREAM_NDJSON,  // 每行一个json值（NDJSON），逐行读取，空行被忽略
+        STREAM_DOCUMENT // 单个json文档，作为唯一的元素读取，之后只能有空白字符
+    };
+
+    // 逐个读取文件中最外层数组的元素，每次只解析一个元素，适合无法整个读入内存的大文件
+    // 文件按块读入一个滑动窗口，已经解析过的部分会被丢弃，内存占用只取决于块的大小和最大的单个元素
+    // 后台线程在解析当前元素的同时预读后面的块，放入ring_size块的环形缓冲区，元素必须是对象或数组
+    // 定义了SHANHJ_JSON_ZLIB时，以gzip头开始的文件由后台线程边读边解压，解压和解析在两个线程中同时进行
+    // 此时错误信息中的偏移量和行列号都相对于解压后的内容
+    class JsonArrayReader
+    {
+    public:
+        // 打开path指向的文件，chunk_size为每次读取（解压时为解压出）的字节数，limits对每个元素单独生效
+        // format为文件的格式，ring_size为后台线程最多预读的块数
+        explicit JsonArrayReader(const string &path, ulong chunk_size = 1 << 20,
+                                 const parse_limits &limits = parse_limits(), stream_format format = STREAM_ARRAY,
+                                 ulong ring_size = 2);
+        ~JsonArrayReader();
+        JsonArrayReader(const JsonArrayReader &) = delete;
+        JsonArrayReader &operator=(const JsonArrayReader &) = delete;
+
+        // 读取下一个元素存入element，数组（或文件）结束或出错时返回false，可以通过failed区分
+        // 下一个元素的类型与element不同时视为出错
+        bool next(JsonObject &element);
+        bool next(JsonArray &element);
+        // 是否因为文件无法读取或者格式错误而停止
+        bool failed() const;
+        // 出错时的信息，偏移量和行列号都相对于文件开头
+        const parse_error &last_error() const;
+
+    private:
+        enum read_state
+        {
+            STATE_BEGIN,   // 期望'['
+            STATE_FIRST,   // 期望第一个元素或']'
+            STATE_ELEMENT, // 期望','之后的元素
+            STATE_NEXT,    // 期望','或']'
+            STATE_END,     // 数组已经结束
+            STATE_FAILED   // 出错
+        };
+
+        template <typename T>
+        bool next_element(T &element);
+        // 丢弃窗口中已经解析过的部分，并把后台读好的一块追加到窗口末尾，文件已经读完时返回false
+        bool fill();
+        // 窗口中的内容已经全部处理，读入下一块，文件已经读完时结束读取并返回false，读取出错时记录错误
+        bool next_chunk(const char *expected);
+        // 后台线程，环形缓冲区中有空位时就读取下一块
+        void read_ahead();
+        // 读取一块到out中，返回读到的字节数，end表示已经读到末尾，bad表示读取或解压出错
+        ulong read_chunk(char *out, bool &end, bool &bad);
+#ifdef SHANHJ_JSON_ZLIB
+        ulong inflate_chunk(char *out, bool &end, bool &bad);
+#endif
+        // 记录错误，position为窗口中出错的位置
+        bool fail(const char *position, error_code code, const char *expected);
+
+        FILE *file = nullptr;
+        ulong chunk_size;
+        Parser parser;
+        stream_format format;
+        read_state state = STATE_BEGIN;
+        parse_error error;
+
+        string window;           // 已读入但还没有丢弃的内容
+        ulong consumed = 0;      // window中已经解析过的字节数
+        ulong window_offset = 0; // window[0]在文件中的偏移
+        ulong lines = 0;         // 已丢弃部分中的换行符个数
+        ulong column = 0;        // 已丢弃部分最后一行的utf-8字符数
+
+        // 以下成员只由后台线程访问
+        string input;    // 判断文件格式时读入的开头，不是gzip文件时作为第一块的开头；解压时为压缩数据的缓冲区
+        ulong input_pos = 0; // input中已经使用的字节数
+#ifdef SHANHJ_JSON_ZLIB
+        static constexpr ulong compressed_chunk = 1 << 16; // 每次读入的压缩数据的字节数
+        bool gzip = false;
+        bool input_end = false;   // 压缩数据是否已经全部读入input
+        bool member_open = false; // 是否正在解压一个gzip成员，多个gzip文件首尾相连时依次解压
+        z_stream inflater;
+#endif
+
+        // 以下成员由后台线程和当前线程共享，通过lock保护
+        mutex lock;
+        condition_variable changed;
+        // 环形缓冲区，[ring_head, ring_head + ring_count)中的块已经读好，后台线程只写入其余的空位，不需要加锁
+        vector<string> ring;
+        vector<ulong> ring_sizes;
+        ulong ring_head = 0;
+        ulong ring_count = 0;
+        bool file_end = false;      // 后台线程是否已经读到文件末尾
+        bool io_error = false;      // 读取文件时是否出错
+        bool stop = false;          // 通知后台线程退出
+        bool drained = false;       // 最后一块是否已经被取走，只由当前线程访问
+        thread reader;
+    };
+
+    // 编译后的JSON Schema，通过Parser::schema或者parser_from_array在解析的同时校验
+    // 支持type、properties、required、items、enum、minimum、maximum、minLength、maxLength、minItems、maxItems
+    // integer按值判断，1.0、1e2这样值为整数的数字也算integer
+    // 编译后不再修改，可以被多个Parser同时使用
+    class JsonSchema
+    {
+    public:
+        // 编译schema，出现不支持的关键字、格式错误或者required超过64个时返回false
+        // 编译失败的schema不接受任何文档
+        bool compile(const JsonObject &schema);
+
+    private:
+        friend class Parser;
+
+        // type允许的类型
+        enum type_bit : unsigned
+        {
+            BIT_STRING = 1,
+            BIT_INTEGER = 2,
+            BIT_NUMBER = 4,
+            BIT_BOOLEAN = 8,
+            BIT_OBJECT = 16,
+            BIT_ARRAY = 32,
+            BIT_NULL = 64,
+            BIT_ANY = 127
+        };
+
+        // 对象中的一个键，schema为它的值对应的节点，required为它在required中的位置，-1表示没有
+        struct field
+        {
+            long schema = -1;
+            long required = -1;
+        };
+
+        struct node
+        {
+            unsigned types = BIT_ANY;
+            map<string, field> fields;
+            ulong required_count = 0;
+            long items = -1;
+            bool has_enum = false;
+            vector<string> enum_strings;
+            vector<double> enum_numbers;
+            unsigned enum_literals = 0; // 第0、1、2位分别表示false、true、null
+            double minimum = -HUGE_VAL;
+            double maximum = HUGE_VAL;
+            ulong min_length = 0, max_length = ULONG_MAX; // 按utf-8字符计数
+            ulong min_items = 0, max_items = ULONG_MAX;
+        };
+
+        // 编译一个子schema，返回节点的下标，失败时返回-1
+        long compile_node(const JsonObject &schema);
+        // 读取c中的数字，value不是数字时返回false
+        template <typename C>
+        static bool read_number(const C &c, const pair<value_type, ulong> &value, double &result);
+        static bool read_count(const JsonObject &schema, const pair<value_type, ulong> &value, ulong &result);
+        static bool read_type(const string &name, unsigned &types);
+
+        // 以下函数在值不符合rule时返回违反的关键字，符合时返回空指针
+        const char *check_string(long rule, const string &value) const;
+        const char *check_number(long rule, const char *begin, const char *end) const;
+        const char *check_literal(long rule, value_type type, bool value) const;
+        const char *check_container(long rule, value_type type) const;
+        // 检查结束的容器，count为值的个数，seen为出现过的required键
+        const char *check_end(long rule, bool is_object, ulong count, uint64_t seen) const;
+        // 返回对象中键为key的值对应的节点，没有限制时返回-1，同时记录出现过的required键
+        long property(long rule, const string &key, uint64_t &seen) const;
+
+        vector<node> nodes; // 第0个为根节点
+    };
+
+    // 字段投影，通过Parser::projection或者parser_from_array在解析时只构造选中的成员
+    // 路径使用JSON Pointer表示，比如"/user/name"，数组不占路径中的层级，作用于数组的投影对它的每一个对象元素生效
+    // 选中一个值时同时选中它的整个子树，编译后不再修改，可以被多个Parser同时使用
+    class JsonProjection
+    {
+    public:
+        JsonProjection();
+        // 加入一条要保留的路径，路径格式错误时返回false，空路径表示保留整个文档
+        bool add(const string &path);
+
+    private:
+        friend class Parser;
+
+        // 对象中要保留的键和它的值对应的节点，-1表示保留整个值
+        struct node
+        {
+            map<string, long> fields;
+        };
+
+        // 查找节点mask中键为key的值对应的节点，不需要保留时返回false
+        bool select(long mask, const string &key, long &child) const;
+
+        vector<node> nodes; // 第0个为根节点
+        bool whole = false; // 是否保留整个文档
+    };
+
+    // 编译期解析json字面量得到的节点，按先序排列，容器节点之后紧跟它的所有子孙节点
+    struct static_node
+    {
+        value_type type = TYPE_NULL;
+        ulong span = 1;           // 以该节点为根的子树中的节点个数，用来跳过整个子树
+        ulong size = 0;           // 容器中值的个数，布尔类型则为true(1)或false(0)
+        ulong key_offset = 0;     // 在对象中时，转义后的键在chars中的位置
+        ulong key_length = 0;
+        ulong offset = 0;         // 字符串转义后的内容或者数字的原文在chars中的位置
+        ulong length = 0;
+        int64_t int_value = 0;
+        double double_value = 0;
+        bool exact = false;       // 浮点数能否在编译期精确转换，否则读取时由原文转换
+    };
+
+    // 编译期的json解析器，只在常量表达式中使用，解析出错时抛出异常，即产生编译错误
+    // nodes和chars为空时只校验并统计节点个数，用来确定StaticJson的大小
+    // 运行时没有栈溢出的问题，因此直接使用递归，嵌套深度受编译器的常量表达式递归深度限制
+    class StaticParser
+    {
+    public:
+        constexpr StaticParser(const char *text, static_node *nodes, char *chars);
+        // 解析整个字面量，最外层必须是对象或数组，之后只能有空白字符，返回节点个数
+        constexpr ulong run();
+
+    private:
+        constexpr void check(bool ok, const char *message) const;
+        constexpr void skip_space();
+        constexpr void parse_value();
+        // 解析pos之后的字符串直到 " ，转义后的内容写入chars
+        constexpr void parse_string(ulong &offset, ulong &length);
+        constexpr void parse_number(ulong index);
+        constexpr void parse_literal(const char *literal);
+
+        const char *text;
+        static_node *nodes;
+        char *chars;
+        ulong pos = 0;   // text中当前的位置
+        ulong count = 0; // 已经解析出的节点个数
+        ulong used = 0;  // chars中已经使用的字节数
+    };
+
+    // 编译期解析出的只读文档中的一个值，只引用静态存储区中的节点，本身不拥有数据
+    // 读取函数的含义与JsonObject/JsonArray相同，字符串以string_view返回，不需要拷贝
+    class StaticValue
+    {
+    public:
+        // 默认构造的值为null，用来接收get_object/get_array的结果
+        constexpr StaticValue() : node(&null_node), chars("") {}
+        constexpr StaticValue(const static_node *node, const char *chars) : node(node), chars(chars) {}
+
+        value_type type() const;
+        // 对象或数组中值的个数
+        ulong size() const;
+        bool get_string(string_view key, string_view &result) const;
+        bool get_boolean(string_view key, bool &result) const;
+        bool get_int(string_view key, int64_t &result) const;
+        bool get_double(string_view key, double &result) const;
+        bool get_object(string_view key, StaticValue &result) const;
+        bool get_array(string_view key, StaticValue &result) const;
+        bool get_string(ulong index, string_view &result) const;
+        bool get_boolean(ulong index, bool &result) const;
+        bool get_int(ulong index, int64_t &result) const;
+        bool get_double(ulong index, double &result) const;
+        bool get_object(ulong index, StaticValue &result) const;
+        bool get_array(ulong index, StaticValue &result) const;
+
+    private:
+        // 查找对象中键为key的值，同一个键出现多次时以最后一次为准，不存在时返回空指针
+        const static_node *find(string_view key) const;
+        // 返回数组中的第index个值，不存在时返回空指针
+        const static_node *at(ulong index) const;
+        bool read_string(const static_node *value, string_view &result) const;
+        bool read_double(const static_node *value, double &result) const;
+
+        static constexpr static_node null_node = {};
+        const static_node *node;
+        const char *chars;
+    };
+
+    // 编译期解析出的只读文档，通过SHANHJ_JSON_STATIC定义，Nodes为节点个数，Chars为字面量的字节数
+    // 整个文档在编译期构造并放在静态存储区中，程序启动时不需要解析，读取函数与StaticValue相同
+    template <ulong Nodes, ulong Chars>
+    class StaticJson : public StaticValue
+    {
+    public:
+        constexpr explicit StaticJson(const char *text) : StaticValue(nodes, chars)
+        {
+            StaticParser(text, nodes, chars).run();
+        }
+        StaticJson(const StaticJson &) = delete;
+        StaticJson &operator=(const StaticJson &) = delete;
+
+    private:
+        static_node nodes[Nodes] = {};
+        char chars[Chars] = {};
+    };
+
+    // 校验json字面量并返回节点个数，不合法时产生编译错误
+    constexpr ulong static_node_count(const char *text);
+
+// 在编译期解析json字面量并定义名为name的只读文档，字面量不合法时编译出错
+// 用法：SHANHJ_JSON_STATIC(config, R"({"port": 8080})"); config.get_int("port", port);
+#define SHANHJ_JSON_STATIC(name, literal) \
+    static constexpr Shanhj_Json::StaticJson<Shanhj_Json::static_node_count(literal), sizeof(literal)> name { literal }
+
+    // 冻结文档中的一个值，字符串和容器只保存偏移量，不含指针，映像可以原样写入文件
+    struct frozen_value
+    {
+        uint8_t type = TYPE_NULL;
+        uint8_t reserved[3] = {};
+        uint32_t size = 0; // 字符串的字节数、容器中值的个数或者布尔值
+        uint64_t data = 0; // 整数或浮点数的二进制表示、字符串在chars中的偏移或者容器的数据块在映像中的偏移
+    };
+
+    // 冻结对象中的一个键值对，按键的完美哈希值排列，每项32字节，不会跨越缓存行
+    struct frozen_entry
+    {
+        uint64_t key_offset; // 键在chars中的偏移
+        uint32_t key_length;
+        uint32_t tag; // 键的哈希值的低32位，不相等时不需要比较键的内容
+        frozen_value value;
+    };
+
+    // 冻结对象的数据块的头部，之后依次是size个frozen_entry和bucket_count个uint32_t的位移值
+    struct frozen_object
+    {
+        uint64_t seed; // 计算键的哈希值时使用的种子
+        uint32_t bucket_count;
+        uint32_t reserved[5]; // 使表项从32字节对齐的位置开始
+    };
+
+    // 冻结文档的映像的头部，之后是按先序排列的对象和数组的数据块，最后是所有字符串和键的内容
+    // 冻结数组的数据块就是size个连续的frozen_value
+    struct frozen_header
+    {
+        char magic[8];       // "SHJFRZ1"
+        uint64_t byte_order; // 写入0x0102030405060708，用来识别字节序不同的机器生成的映像
+        uint64_t size;       // 映像的总字节数
+        uint64_t chars_offset;
+        uint64_t chars_size;
+        frozen_value root;
+        uint64_t reserved;
+    };
+
+    // 冻结文档中的一个值，只引用FrozenJson的映像，本身不拥有数据，不能在FrozenJson销毁后使用
+    // 读取函数的含义与StaticValue相同，对象按完美哈希查找，数组按下标直接定位
+    class FrozenValue
+    {
+    public:
+        // 默认构造的值为null，用来接收get_object/get_array的结果
+        FrozenValue() = default;
+
+        value_type type() const;
+        // 对象或数组中值的个数
+        ulong size() const;
+        bool get_string(string_view key, string_view &result) const;
+        bool get_boolean(string_view key, bool &result) const;
+        bool get_int(string_view key, int64_t &result) const;
+        bool get_double(string_view key, double &result) const;
+        bool get_object(string_view key, FrozenValue &result) const;
+        bool get_array(string_view key, FrozenValue &result) const;
+        bool get_string(ulong index, string_view &result) const;
+        bool get_boolean(ulong index, bool &result) const;
+        bool get_int(ulong index, int64_t &result) const;
+        bool get_double(ulong index, double &result) const;
+        bool get_object(ulong index, FrozenValue &result) const;
+        bool get_array(ulong index, FrozenValue &result) const;
+
+    protected:
+        FrozenValue(const frozen_value *value, const char *image, const char *chars);
+        // 查找对象中键为key的值，不存在时返回空指针
+        const frozen_value *find(string_view key) const;
+        // 返回数组中的第index个值，不存在时返回空指针
+        const frozen_value *at(ulong index) const;
+        bool read_string(const frozen_value *value, string_view &result) const;
+        bool read_container(const frozen_value *value, value_type type, FrozenValue &result) const;
+
+        static constexpr frozen_value null_value = {};
+        const frozen_value *value = &null_value;
+        const char *image = nullptr;
+        const char *chars = nullptr;
+    };
+
+    // 冻结的只读文档，通过JsonObject::freeze或JsonArray::freeze生成，读取函数与FrozenValue相同
+    // 对象查找时只计算一次键的哈希值，然后访问一个位移值和一个表项，不需要逐个比较键
+    // 映像中只有偏移量，可以用save写入文件，之后由map映射，多个进程映射同一个文件时共享同一份物理内存
+    // 映像使用本机的字节序，只能在字节序相同的机器之间交换
+    class FrozenJson : public FrozenValue
+    {
+    public:
+        FrozenJson() = default;
+        ~FrozenJson();
+        FrozenJson(FrozenJson &&other) noexcept;
+        FrozenJson &operator=(FrozenJson &&other) noexcept;
+        FrozenJson(const FrozenJson &) = delete;
+        FrozenJson &operator=(const FrozenJson &) = delete;
+
+        // 使用[data, data + size)中的映像，不复制，data需要8字节对齐并且在使用期间保持有效
+        // 加载时检查一遍所有的偏移量，映像不完整或者偏移量越界时返回false，之后的读取不再检查边界
+        bool attach(const char *data, ulong size);
+        // 只读映射path指向的文件，不支持mmap的平台上读入内存，失败时返回false
+        bool map(const string &path);
+        // 将映像写入path指向的文件，之后可以通过map读取
+        bool save(const string &path) const;
+        // 映像的起始位置和字节数，没有内容时为空指针和0
+        const char *data() const;
+        ulong size_in_bytes() const;
+
+    private:
+        friend class JsonObject;
+        friend class JsonArray;
+
+        // 构造映像时的状态
+        struct builder
+        {
+            string blocks;                        // 头部以及对象和数组的数据块
+            string chars;                         // 字符串和键的内容
+            unordered_map<string, uint64_t> keys; // 已经写入chars的键，相同的键只保存一次
+        };
+
+        // 按先序构造root的映像并加载
+        template <typename Root>
+        void build(const Root &root);
+        static frozen_value freeze_container(builder &b, const JsonObject &object);
+        static frozen_value freeze_container(builder &b, const JsonArray &array);
+        template <typename C>
+        static frozen_value freeze_value(builder &b, const C &c, const pair<value_type, ulong> &value);
+        // 在blocks末尾按align对齐并预留bytes个字节，返回预留部分的偏移
+        static uint64_t reserve(builder &b, ulong bytes, ulong align);
+        // 检查[data, data + size)中的映像，合法时指向其中的根节点
+        bool open(const char *data, ulong size);
+        // 释放拥有的内存或映射，恢复为空文档
+        void release();
+
+        struct alignas(64) cache_line
+        {
+            char bytes[64];
+        };
+        vector<cache_line> owned; // 由freeze生成或读入的映像
+        void *mapping = nullptr;  // map映射的地址
+        ulong mapping_size = 0;
+        ulong image_size = 0;
+    };
+
+    // 冻结对象的键所在的桶，由哈希值的高32位映射到[0, bucket_count)
+    inline ulong frozen_bucket(uint64_t hash, ulong bucket_count);
+    // 冻结对象的键在表项中的位置，哈希值加上所在桶的位移值打乱后映射到[0, count)
+    inline ulong frozen_slot(uint64_t hash, uint32_t displacement, ulong count);
+
+    // 字符的分类，解析时按值的第一个字符查表分派
+    enum char_class : uint8_t
+    {
+        CLASS_INVALID, // 不能出现在值的开头
+        CLASS_SPACE,   // json的空白字符：空格、\t、\n、\r
+        CLASS_STRING,  // "
+        CLASS_TRUE,    // t
+        CLASS_FALSE,   // f
+        CLASS_NULL,    // n
+        CLASS_OBJECT,  // {
+        CLASS_ARRAY,   // [
+        CLASS_NUMBER   // -和0-9
+    };
+
+    // 256项的字符分类表，在编译期生成
+    struct char_class_table
+    {
+        constexpr char_class_table() : classes()
+        {
+            classes[(uint8_t)' '] = classes[(uint8_t)'\t'] = classes[(uint8_t)'\n'] = classes[(uint8_t)'\r'] = CLASS_SPACE;
+            classes[(uint8_t)'\"'] = CLASS_STRING;
+            classes[(uint8_t)'t'] = CLASS_TRUE;
+            classes[(uint8_t)'f'] = CLASS_FALSE;
+            classes[(uint8_t)'n'] = CLASS_NULL;
+            classes[(uint8_t)'{'] = CLASS_OBJECT;
+            classes[(uint8_t)'['] = CLASS_ARRAY;
+            classes[(uint8_t)'-'] = CLASS_NUMBER;
+            for (int c = '0'; c <= '9'; c++)
+                classes[c] = CLASS_NUMBER;
+        }
+
+        char_class classes[256];
+    };
+
+    inline constexpr char_class_table char_classes{};
+
+    // 查表返回字符c的分类
+    inline char_class classify_char(char c);
+
+    // 将8个字节中的空白字符所在字节的最高位置1，其他位全部为0
+    inline uint64_t space_bytes(uint64_t word);
+
+    // 跳过json的空白字符，连续的空白每次检查8个字节，如果array到达array_end则返回false
+    // 以下函数的padded为true时表示array_end之后还有input_padding个0字节，扫描时依靠它们结束而不检查边界
+    template <bool padded = false>
+    inline bool skip_space(char *&array, char *array_end);
+
+    // 通过第一个字节的内容返回非ascii字符的utf-8编码的长度
+    // 如果是ascii编码，则返回0
+    inline uint8_t get_utf8_len(char first_c);
+
+    // 返回出错位置的行和列
+    // begin为json序列开始的位置
+    string error_position(char *begin, char *error_pos);
+
+    // 统计[begin, end)中换行符的个数，支持SSE2时每次比较16个字节
+    // line_begin返回最后一个换行符的下一个位置，没有换行符时为begin
+    inline ulong count_newlines(const char *begin, const char *end, const char *&line_begin);
+
+    // 统计[begin, end)中utf-8字符的个数，即不形如10xxxxxx的字节数，支持SSE2时每次比较16个字节
+    inline ulong count_utf8_chars(const char *begin, const char *end);
+
+    // 计算error_pos所在的行号和列号，都从1开始，列号按utf-8字符计数
+    inline void locate_position(const char *begin, const char *error_pos, ulong &line, ulong &column);
+
+    // 返回array之后第一个 " 或 \ 的位置，没有时返回array_end，支持SSE2时每次比较16个字节
+    // padded为true时也会停在'\0'上
+    template <bool padded = false>
+    inline char *find_string_special(char *array, char *array_end);
+
+    // 从带有转义字符的文本中获取一个二进制字符串，遇到 " 停止，如果合法返回true
+    // 自动处理转义字符，结束后array将指向 " 的后一个位置
+    template <bool padded = false>
+    bool get_binary_from_text(char *&array, char *array_end, string &result);
+
+    // 跳过一个字符串并检查其中的转义字符是否合法，但不保存内容，遇到 " 停止，如果合法返回true
+    // 调用时array指向 " 的后一个位置，结束后array将指向 " 的后一个位置
+    bool skip_string(char *&array, char *array_end);
+
+    // 按json的语法跳过一个数字，如果合法返回true，结束后array将指向数字之后的位置
+    // is_double表示数字中是否有小数部分或指数部分
+    template <bool padded = false>
+    bool scan_number(char *&array, char *array_end, bool &is_double);
+
+    // 判断array开头是否为长度为length（4或5）的字面量literal
+    // padded为true时不检查剩余的长度，直接按4个字节的整字比较
+    template <bool padded = false>
+    inline bool match_literal(const char *array, const char *array_end, const char *literal, ulong length);
+    // 字面量不匹配时报告错误的位置：剩余的输入是literal的前缀时返回array_end，即视为输入不完整，否则返回array
+    inline char *literal_mismatch(char *array, char *array_end, const char *literal, ulong length);
+
+    // 将x的各位充分打乱，用于合并哈希值
+    inline uint64_t hash_mix(uint64_t x);
+    // 计算[data, data + length)的哈希值，每次处理16个字节，分成两路互不依赖的乘法以便并行执行
+    inline uint64_t hash_bytes(const char *data, ulong length, uint64_t seed);
+
+    // 将保留原文的数字转换为整数或浮点数，分类不符时返回false
+    // number_text为数字所在容器的number_text
+    inline bool raw_to_int(const string &number_text, const raw_number &number, int64_t &result);
+    inline bool raw_to_double(const string &number_text, const raw_number &number, double &result);
+
+    // 写时复制：node被多个文档共享时先复制一份，使node只属于当前文档，返回可以修改的节点
+    // 复制时只复制这一层，更下层的子树仍然共享
+    template <typename T>
+    T &unshare(shared_ptr<T> &node);
+
+    // 将二进制字符串转成文本，特殊字符进行转义
+    // 如果转换的内容不是utf-8格式，返回空字符串
+    string binary_to_text(const string &binary);
+}
+
+Shanhj_Json::char_class Shanhj_Json::classify_char(char c)
+{
+    return char_classes.classes[(uint8_t)c];
+}
+
+uint64_t Shanhj_Json::space_bytes(uint64_t word)
+{
+    const uint64_t ones = 0x0101010101010101ull, low7 = 0x7F7F7F7F7F7F7F7Full;
+    // 与c异或后为0的字节即等于c，(x & low7) + low7不会向相邻字节进位，只有为0的字节最高位保持为0
+    auto equal = [&](uint8_t c) {
+        uint64_t x = word ^ (ones * c);
+        return ~(((x & low7) + low7) | x | low7);
+    };
+    return equal(' ') | equal('\t') | equal('\n') | equal('\r');
+}
+
+template <bool padded>
+bool Shanhj_Json::skip_space(char *&array, char *array_end)
+{
+    if (!padded && array >= array_end) return false;
+    if (classify_char(*array) != CLASS_SPACE) return array < array_end; // 压缩过的json中大多没有空白
+    const uint64_t all_space = 0x8080808080808080ull;
+    uint64_t word;
+    while ((padded || array_end - array >= 8) && (memcpy(&word, array, 8), space_bytes(word) == all_space))
+        array += 8;
+    while ((padded || array < array_end) && classify_char(*array) == CLASS_SPACE)
+        array++;
+    return array < array_end;
+}
+
+uint8_t Shanhj_Json::get_utf8_len(char first_c)
+{
+    uint8_t c = first_c, len = 0; // 转成无符号数再移位，有符号数左移溢出是未定义行为
+    while (c & 0x80)
+    {
+        len++;
+        c <<= 1;
+    }
+    return len;
+}
+
+std::string Shanhj_Json::error_position(char *begin, char *error_pos)
+{
+    ulong line, column;
+    locate_position(begin, error_pos, line, column);
+    return "lines:" + to_string(line) + ",colum:" + to_string(column);
+}
+
+Shanhj_Json::ulong Shanhj_Json::count_newlines(const char *begin, const char *end, const char *&line_begin)
+{
+    ulong count = 0;
+    line_begin = begin;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)begin);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (!mask) continue;
+        count += bitset<16>(mask).count();
+        line_begin = begin + (31 - __builtin_clz(mask)) + 1; // 最高的置位对应这一块中最后一个换行符
+    }
+#endif
+    for (; begin < end; begin++)
+        if (*begin == '\n')
+        {
+            count++;
+            line_begin = begin + 1;
+        }
+    return count;
+}
+
+Shanhj_Json::ulong Shanhj_Json::count_utf8_chars(const char *begin, const char *end)
+{
+    ulong count = 0;
+#ifdef __SSE2__
+    // 按有符号数比较，后续字节0x80~0xBF即-128~-65，大于-65的字节都是一个字符的开头
+    const __m128i continuation = _mm_set1_epi8(-65);
+    for (; end - begin >= 16; begin += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)begin);
+        count += bitset<16>(_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, continuation))).count();
+    }
+#endif
+    for (; begin < end; begin++)
+        count += (*begin & 0xC0) != 0x80;
+    return count;
+}
+
+void Shanhj_Json::locate_position(const char *begin, const char *error_pos, ulong &line, ulong &column)
+{
+    const char *line_begin;
+    line = count_newlines(begin, error_pos, line_begin) + 1;
+    column = count_utf8_chars(line_begin, error_pos) + 1;
+}
+
+template <bool padded>
+char *Shanhj_Json::find_string_special(char *array, char *array_end)
+{
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\'), zero = _mm_setzero_si128();
+    while (padded || array_end - array >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)array);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        if (padded) special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, zero));
+        int mask = _mm_movemask_epi8(special);
+        if (mask) return array + __builtin_ctz(mask);
+        array += 16;
+    }
+#endif
+    while ((padded || array < array_end) && *array != '\"' && *array != '\\' && (!padded || *array != 0))
+        array++;
+    return array;
+}
+
+template <bool padded>
+bool Shanhj_Json::get_binary_from_text(char *&array, char *array_end, string &result)
+{
+    while (true)
+    {
+        // utf-8多字节字符的每个字节都不小于0x80，不会与 " 和 \ 混淆，不需要转义的部分整段追加
+        char *special = find_string_special<padded>(array, array_end);
+        result.append(array, special);
+        array = special;
+        if (array >= array_end) return false;
+        if (*array == '\"') break;
+        if (*array != '\\') // 只有padded时才会出现，字符串中间的'\0'
+        {
+            result += *array++;
+            continue;
+        }
+        array++; // 转义字符
+        if (array >= array_end) return false;
+        switch (*array)
+        {
+        case 'n':
+            result += '\n';
+            break;
+        case '\"':
+            result += '\"';
+            break;
+        case '\\':
+            result += '\\';
+            break;
+        case 'b':
+            result += '\b';
+            break;
+        case 'f':
+            result += '\f';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case '/':
+            result += '/';
+            break;
+        default: // 不合法的转义字符
+            return false;
+            break;
+        }
+        array++;
+    }
+    array++;
+    return true;
+}
+
+bool Shanhj_Json::skip_string(char *&array, char *array_end)
+{
+    while (true)
+    {
+        array = find_string_special(array, array_end);
+        if (array >= array_end) return false;
+        if (*array == '\"')
+        {
+            array++;
+            return true;
+        }
+        array++; // 转义字符
+        if (array >= array_end) return false;
+        if (!strchr("n\"\\bftr/", *array) || *array == 0) return false; // 不合法的转义字符
+        array++;
+    }
+}
+
+template <bool padded>
+bool Shanhj_Json::scan_number(char *&array, char *array_end, bool &is_double)
+{
+    if (*array == '-' && ++array >= array_end && !padded) return false;
+    if (*array == '0') // 0开头，后面不能再跟数字
+        array++;
+    else if (*array >= '1' && *array <= '9')
+    {
+        while ((padded || array < array_end) && *array >= '0' && *array <= '9')
+            array++;
+    }
+    else // 非数字开头，错误
+        return false;
+    is_double = false;
+    if ((padded || array < array_end) && *array == '.') // 小数部分
+    {
+        is_double = true;
+        char *digits = ++array;
+        while ((padded || array < array_end) && *array >= '0' && *array <= '9')
+            array++;
+        if (array == digits) return false;
+    }
+    if ((padded || array < array_end) && (*array == 'e' || *array == 'E')) // 指数部分
+    {
+        is_double = true;
+        array++;
+        if ((padded || array < array_end) && (*array == '+' || *array == '-')) array++;
+        char *digits = array;
+        while ((padded || array < array_end) && *array >= '0' && *array <= '9')
+            array++;
+        if (array == digits) return false;
+    }
+    return true;
+}
+
+template <bool padded>
+bool Shanhj_Json::match_literal(const char *array, const char *array_end, const char *literal, ulong length)
+{
+    if (!padded) return array_end - array >= (long)length && memcmp(array, literal, length) == 0;
+    uint32_t word, expected;
+    memcpy(&word, array, 4);
+    memcpy(&expected, literal, 4);
+    return word == expected && (length == 4 || array[4] == literal[4]);
+}
+
+char *Shanhj_Json::literal_mismatch(char *array, char *array_end, const char *literal, ulong length)
+{
+    ulong rest = array_end - array;
+    return rest < length && memcmp(array, literal, rest) == 0 ? array_end : array;
+}
+
+uint64_t Shanhj_Json::hash_mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint64_t Shanhj_Json::hash_bytes(const char *data, ulong length, uint64_t seed)
+{
+    const uint64_t k1 = 0x9E3779B97F4A7C15ull, k2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t a = seed ^ (length * k1), b = seed + k2;
+    const char *end = data + length;
+    uint64_t x, y;
+    for (; end - data >= 16; data += 16)
+    {
+        memcpy(&x, data, 8);
+        memcpy(&y, data + 8, 8);
+        a = (a ^ x) * k1;
+        b = (b ^ y) * k2;
+        a ^= a >> 29;
+        b ^= b >> 29;
+    }
+    if (end - data >= 8)
+    {
+        memcpy(&x, data, 8);
+        a = (a ^ x) * k1;
+        data += 8;
+    }
+    y = 0;
+    memcpy(&y, data, end - data);
+    b = (b ^ y) * k2;
+    return hash_mix(a ^ (b << 31 | b >> 33));
+}
+
+bool Shanhj_Json::raw_to_int(const string &number_text, const raw_number &number, int64_t &result)
+{
+    if (number.kind != NUMBER_INT64) return false;
+    const char *digit = number_text.data() + number.offset, *end = digit + number.length;
+    bool negative = *digit == '-';
+    uint64_t value = 0;
+    for (digit += negative; digit < end; digit++) // 分类时已经确认不会溢出
+        value = value * 10 + (*digit - '0');
+    result = negative ? (int64_t)(0 - value) : (int64_t)value;
+    return true;
+}
+
+bool Shanhj_Json::raw_to_double(const string &number_text, const raw_number &number, double &result)
+{
+    if (number.kind == NUMBER_INT64) return false;
+    char buffer[64]; // strtod需要以'\0'结尾的字符串
+    if (number.length < sizeof(buffer))
+    {
+        memcpy(buffer, number_text.data() + number.offset, number.length);
+        buffer[number.length] = 0;
+        result = strtod(buffer, nullptr);
+    }
+    else
+        result = strtod(number_text.substr(number.offset, number.length).c_str(), nullptr);
+    return true;
+}
+
+template <typename T>
+T &Shanhj_Json::unshare(shared_ptr<T> &node)
+{
+    if (node.use_count() > 1) node = make_shared<T>(*node);
+    return *node;
+}
+
+std::string Shanhj_Json::binary_to_text(const string &binary)
+{
+    string result;
+    for (ulong i = 0; i < binary.size(); i++)
+    {
+        ulong len = get_utf8_len(binary[i]);
+        if (len == 0) // ASCII字符
+        {
+            switch (binary[i])
+            {
+            case '\n':
+                result += "\\n";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            case '\f':
+                result += "\\f";
+                break;
+            case '\b':
+                result += "\\b";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '/':
+                result += "\\/";
+                break;
+            case '\"':
+                result += "\\\"";
+                break;
+            default:
+                result += binary[i];
+                break;
+            }
+        }
+        else // 非ASCII字符
+        {
+            len = min(len, binary.size() - i); // 末尾不完整的字符只复制剩下的字节
+            result.append(binary, i, len);
+            i += len - 1;
+        }
+    }
+    return result;
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, const string &value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_STRING)
+    {
+        v_string[position[key].second] = value;
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_STRING, v_string.size()};
+        v_string.push_back(value);
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, const char *value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_STRING)
+    {
+        v_string[position[key].second] = value;
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_STRING, v_string.size()};
+        v_string.push_back(value);
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, bool value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_BOOLEAN)
+        position[key].second = value;
+    else
+        position[key] = {TYPE_BOOLEAN, value};
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, int value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_INT)
+    {
+        v_int[position[key].second] = value;
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_INT, v_int.size()};
+        v_int.push_back(value);
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, int64_t value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_INT)
     {
         v_int[position[key].second] = value;
     }
     else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_INT, v_int.size()};
-        v_int.push_back(value);
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_INT, v_int.size()};
+        v_int.push_back(value);
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, double value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_DOUBLE)
+    {
+        v_double[position[key].second] = value;
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_DOUBLE, v_double.size()};
+        v_double.push_back(value);
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, const JsonObject &value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_OBJECT)
+    {
+        v_object[position[key].second] = make_shared<JsonObject>(value);
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_OBJECT, v_object.size()};
+        v_object.push_back(make_shared<JsonObject>(value));
+    }
+}
+
+void Shanhj_Json::JsonObject::insert(const string &key, const JsonArray &value)
+{
+    modified();
+    // 已经存在相同键值的变量，并且是同一类型的
+    if (position.count(key) && position[key].first == TYPE_ARRAY)
+    {
+        v_array[position[key].second] = make_shared<JsonArray>(value);
+    }
+    else
+    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
+        // 旧的键值对仍然留在vector里，但不再使用
+        position[key] = {TYPE_ARRAY, v_array.size()};
+        v_array.push_back(make_shared<JsonArray>(value));
+    }
+}
+
+bool Shanhj_Json::JsonObject::get_string(const string &key, string &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first != TYPE_STRING) return false; // 不存在该类型的键值对
+    result = v_string[pos.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_boolean(const string &key, bool &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first != TYPE_BOOLEAN) return false; // 不存在该类型的键值对
+    result = pos.second;
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_int(const string &key, int64_t &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first == TYPE_NUMBER) return raw_to_int(number_text, v_number[pos.second], result);
+    if (pos.first != TYPE_INT) return false; // 不存在该类型的键值对
+    result = v_int[pos.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_double(const string &key, double &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first == TYPE_NUMBER) return raw_to_double(number_text, v_number[pos.second], result);
+    if (pos.first != TYPE_DOUBLE) return false; // 不存在该类型的键值对
+    result = v_double[pos.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_object(const string &key, JsonObject &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first != TYPE_OBJECT) return false; // 不存在该类型的键值对
+    result = *v_object[pos.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_array(const string &key, JsonArray &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    auto pos = iter->second;
+    if (pos.first != TYPE_ARRAY) return false; // 不存在该类型的键值对
+    result = *v_array[pos.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonObject::get_value(const string &key, JsonValue &result) const
+{
+    auto iter = position.find(key);
+    if (iter == position.end()) return false; // 不存在该键值
+    result = JsonValue(this, nullptr, iter->second);
+    return true;
+}
+
+Shanhj_Json::JsonObject::const_iterator::const_iterator(const JsonObject *owner,
+                                                       map<string, pair<Shanhj_Json::value_type, ulong>>::const_iterator iter)
+    : owner(owner), iter(iter)
+{
+}
+
+Shanhj_Json::JsonObject::const_iterator::reference Shanhj_Json::JsonObject::const_iterator::operator*() const
+{
+    return {iter->first, JsonValue(owner, nullptr, iter->second)};
+}
+
+Shanhj_Json::JsonObject::const_iterator &Shanhj_Json::JsonObject::const_iterator::operator++()
+{
+    ++iter;
+    return *this;
+}
+
+Shanhj_Json::JsonObject::const_iterator Shanhj_Json::JsonObject::const_iterator::operator++(int)
+{
+    const_iterator old = *this;
+    ++*this;
+    return old;
+}
+
+bool Shanhj_Json::JsonObject::const_iterator::operator==(const const_iterator &other) const
+{
+    return iter == other.iter;
+}
+
+bool Shanhj_Json::JsonObject::const_iterator::operator!=(const const_iterator &other) const
+{
+    return iter != other.iter;
+}
+
+Shanhj_Json::JsonObject::const_iterator Shanhj_Json::JsonObject::begin() const
+{
+    return const_iterator(this, position.begin());
+}
+
+Shanhj_Json::JsonObject::const_iterator Shanhj_Json::JsonObject::end() const
+{
+    return const_iterator(this, position.end());
+}
+
+void Shanhj_Json::JsonObject::visit(JsonVisitor &visitor) const
+{
+    if (visitor.object_begin(*this))
+    {
+        for (auto &member : position)
+        {
+            visitor.key(member.first);
+            JsonValue(this, nullptr, member.second).visit(visitor);
+        }
+    }
+    visitor.object_end(*this);
+}
+
+void Shanhj_Json::JsonObject::clear()
+{
+    modified();
+    position.clear();
+    v_array.clear();
+    v_double.clear();
+    v_int.clear();
+    v_number.clear();
+    number_text.clear();
+    v_object.clear();
+    v_string.clear();
+}
+
+bool Shanhj_Json::JsonObject::remove(const string &key)
+{
+    modified();
+    return position.erase(key) > 0; // 值仍然留在vector里，但不再使用
+}
+
+bool Shanhj_Json::JsonObject::apply_patch(const JsonArray &patch)
+{
+    return JsonPatch::apply(this, nullptr, patch);
+}
+
+void Shanhj_Json::JsonObject::apply_merge_patch(const JsonObject &patch)
+{
+    JsonPatch::merge(*this, patch);
+}
+
+std::string Shanhj_Json::JsonObject::output_to_string(long indent) const
+{
+    if (output_cache) return cached_output(indent)->text;
+    string result;
+    output(result, indent, false);
+    return result;
+}
+
+std::string Shanhj_Json::JsonObject::output_parallel(long indent, ulong threads) const
+{
+    if (output_cache) // 缓存有效时直接返回，否则并行生成，根节点不生成缓存
+    {
+        auto text = atomic_load(&cache.text);
+        if (text && text->indent == indent) return text->text;
+    }
+    return ParallelOutput::output(*this, indent, threads);
+}
+
+void Shanhj_Json::JsonObject::set_output_cache(bool enable)
+{
+    output_cache = enable;
+    if (!enable) drop_cache();
+}
+
+std::shared_ptr<const Shanhj_Json::output_text> Shanhj_Json::JsonObject::cached_output(long indent) const
+{
+    auto text = atomic_load(&cache.text);
+    if (!text || text->indent != indent)
+    {
+        auto fresh = make_shared<output_text>();
+        fresh->indent = indent;
+        output(fresh->text, indent, true);
+        text = std::move(fresh);
+        atomic_store(&cache.text, text);
+    }
+    return text;
+}
+
+void Shanhj_Json::JsonObject::drop_cache()
+{
+    atomic_store(&cache.text, shared_ptr<const output_text>());
+    for (auto &object : v_object) // 共享的子树可能正在被其他文档使用，不释放
+    {
+        if (object.use_count() == 1) object->drop_cache();
+    }
+    for (auto &array : v_array)
+    {
+        if (array.use_count() == 1) array->drop_cache();
+    }
+}
+
+void Shanhj_Json::JsonObject::modified()
+{
+    atomic_store(&cache.text, shared_ptr<const output_text>());
+    hash_value.value.store(0, memory_order_relaxed);
+}
+
+uint64_t Shanhj_Json::JsonObject::hash() const
+{
+    uint64_t value = hash_value.value.load(memory_order_relaxed);
+    if (value) return value;
+    value = JsonPatch::hash(*this);
+    hash_value.value.store(value, memory_order_relaxed);
+    return value;
+}
+
+bool Shanhj_Json::JsonObject::operator==(const JsonObject &other) const
+{
+    return this == &other || (!JsonPatch::hash_differs(*this, other) && JsonPatch::equal(*this, other));
+}
+
+bool Shanhj_Json::JsonObject::operator!=(const JsonObject &other) const
+{
+    return !(*this == other);
+}
+
+void Shanhj_Json::JsonObject::output(string &result, long indent, bool cached) const
+{
+    output_begin(result, indent);
+    output_members(result, position.begin(), position.end(), true, indent, cached);
+    output_end(result, indent);
+}
+
+void Shanhj_Json::JsonObject::output_begin(string &result, long indent) const
+{
+    result += "{";
+    if (position.size() && indent >= 0) result += '\n';
+}
+
+void Shanhj_Json::JsonObject::output_end(string &result, long indent) const
+{
+    if (position.size() && indent >= 0)
+    {
+        result += '\n';
+        for (int i = 0; i < indent; i++)
+            result += ' ';
+    }
+    result += "}";
+}
+
+void Shanhj_Json::JsonObject::output_key(string &result, const string &key, bool first, long indent)
+{
+    if (!first)
+    {
+        result += ',';
+        if (indent >= 0) result += '\n';
+    }
+    if (indent >= 0)
+    {
+        for (int i = 0; i < indent + 4; i++) // 缩进
+            result += ' ';
+    }
+    result += '\"';
+    result += binary_to_text(key);
+    result += "\":";
+    if (indent >= 0) result += ' ';
+}
+
+void Shanhj_Json::JsonObject::output_members(string &result, member_iterator begin, member_iterator end, bool first,
+                                             long indent, bool cached) const
+{
+    for (auto iter = begin; iter != end; iter++, first = false)
+    {
+        output_key(result, iter->first, first, indent);
+        switch (iter->second.first)
+        {
+        case TYPE_STRING:
+            result += '\"';
+            result += binary_to_text(v_string[iter->second.second]);
+            result += '\"';
+            break;
+        case TYPE_BOOLEAN:
+            result += iter->second.second ? "true" : "false";
+            break;
+        case TYPE_INT:
+            result += to_string(v_int[iter->second.second]);
+            break;
+        case TYPE_DOUBLE:
+            result += to_string(v_double[iter->second.second]);
+            break;
+        case TYPE_NUMBER:
+            result.append(number_text, v_number[iter->second.second].offset, v_number[iter->second.second].length);
+            break;
+        case TYPE_OBJECT:
+            if (cached)
+                result += v_object[iter->second.second]->cached_output(indent >= 0 ? indent + 4 : -1)->text;
+            else
+                v_object[iter->second.second]->output(result, indent >= 0 ? indent + 4 : -1, false);
+            break;
+        case TYPE_ARRAY:
+            if (cached)
+                result += v_array[iter->second.second]->cached_output(indent >= 0 ? indent + 4 : -1)->text;
+            else
+                v_array[iter->second.second]->output(result, indent >= 0 ? indent + 4 : -1, false);
+            break;
+        case TYPE_NULL:
+            result += "null";
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+char *Shanhj_Json::JsonObject::parser_from_array(char *array_begin, char *array_end, bool &result,
+                                                 const parse_limits &limits)
+{
+    Parser parser(limits);
+    return parser.parse(array_begin, array_end, *this, result);
+}
+
+char *Shanhj_Json::JsonObject::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                 const parse_limits &limits)
+{
+    Parser parser(limits);
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+char *Shanhj_Json::JsonObject::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                 const JsonSchema &schema, const parse_limits &limits)
+{
+    Parser parser(limits);
+    parser.schema = &schema;
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+char *Shanhj_Json::JsonObject::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                 const JsonProjection &projection, const parse_limits &limits)
+{
+    Parser parser(limits);
+    parser.projection = &projection;
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+void Shanhj_Json::JsonArray::insert(const string &value)
+{
+    modified();
+    if (!append_packed(TYPE_STRING, 0)) position.push_back({TYPE_STRING, v_string.size()});
+    v_string.push_back(value);
+}
+
+void Shanhj_Json::JsonArray::insert(const char *value)
+{
+    modified();
+    if (!append_packed(TYPE_STRING, 0)) position.push_back({TYPE_STRING, v_string.size()});
+    v_string.push_back(value);
+}
+
+void Shanhj_Json::JsonArray::insert(bool value)
+{
+    modified();
+    if (!append_packed(TYPE_BOOLEAN, value)) position.push_back({TYPE_BOOLEAN, value});
+}
+void Shanhj_Json::JsonArray::insert(int value)
+{
+    insert((int64_t)value);
+}
+void Shanhj_Json::JsonArray::insert(int64_t value)
+{
+    modified();
+    if (append_number(value, 0, false)) return;
+    position.push_back({TYPE_INT, v_int.size()});
+    v_int.push_back(value);
+}
+void Shanhj_Json::JsonArray::insert(double value)
+{
+    modified();
+    if (append_number(0, value, true)) return;
+    position.push_back({TYPE_DOUBLE, v_double.size()});
+    v_double.push_back(value);
+}
+void Shanhj_Json::JsonArray::insert(const JsonObject &value)
+{
+    modified();
+    append_packed(TYPE_OBJECT, 0); // 对象和数组不能压缩，只会转换为普通形式
+    position.push_back({TYPE_OBJECT, v_object.size()});
+    v_object.push_back(make_shared<JsonObject>(value));
+}
+
+void Shanhj_Json::JsonArray::insert(const JsonArray &value)
+{
+    modified();
+    append_packed(TYPE_ARRAY, 0); // 对象和数组不能压缩，只会转换为普通形式
+    position.push_back({TYPE_ARRAY, v_array.size()});
+    v_array.push_back(make_shared<JsonArray>(value));
+}
+
+bool Shanhj_Json::JsonArray::get_string(ulong index, string &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first != TYPE_STRING) return false;
+    result = v_string[entry.second];
+    return true;
+}
+bool Shanhj_Json::JsonArray::get_boolean(ulong index, bool &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first != TYPE_BOOLEAN) return false;
+    result = entry.second;
+    return true;
+}
+bool Shanhj_Json::JsonArray::get_int(ulong index, int64_t &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first == TYPE_NUMBER) return raw_to_int(number_text, v_number[entry.second], result);
+    if (entry.first != TYPE_INT) return false;
+    result = v_int[entry.second];
+    return true;
+}
+bool Shanhj_Json::JsonArray::get_double(ulong index, double &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first == TYPE_NUMBER) return raw_to_double(number_text, v_number[entry.second], result);
+    if (entry.first != TYPE_DOUBLE) return false;
+    result = v_double[entry.second];
+    return true;
+}
+bool Shanhj_Json::JsonArray::get_object(ulong index, JsonObject &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first != TYPE_OBJECT) return false;
+    result = *v_object[entry.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonArray::get_array(ulong index, JsonArray &result) const
+{
+    if (index >= size()) return false;
+    auto entry = entry_at(index);
+    if (entry.first != TYPE_ARRAY) return false;
+    result = *v_array[entry.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonArray::get_value(ulong index, JsonValue &result) const
+{
+    if (index >= size()) return false;
+    result = JsonValue(nullptr, this, entry_at(index));
+    return true;
+}
+
+Shanhj_Json::JsonArray::const_iterator::const_iterator(const JsonArray *owner, ulong index,
+                                                      list<pair<Shanhj_Json::value_type, ulong>>::const_iterator iter)
+    : owner(owner), index(index), iter(iter)
+{
+}
+
+Shanhj_Json::JsonArray::const_iterator::reference Shanhj_Json::JsonArray::const_iterator::operator*() const
+{
+    if (owner->packed != TYPE_NULL) return JsonValue(nullptr, owner, owner->entry_at(index));
+    return JsonValue(nullptr, owner, *iter);
+}
+
+Shanhj_Json::JsonArray::const_iterator &Shanhj_Json::JsonArray::const_iterator::operator++()
+{
+    if (owner->packed == TYPE_NULL) ++iter;
+    index++;
+    return *this;
+}
+
+Shanhj_Json::JsonArray::const_iterator Shanhj_Json::JsonArray::const_iterator::operator++(int)
+{
+    const_iterator old = *this;
+    ++*this;
+    return old;
+}
+
+bool Shanhj_Json::JsonArray::const_iterator::operator==(const const_iterator &other) const
+{
+    return index == other.index;
+}
+
+bool Shanhj_Json::JsonArray::const_iterator::operator!=(const const_iterator &other) const
+{
+    return index != other.index;
+}
+
+Shanhj_Json::JsonArray::const_iterator Shanhj_Json::JsonArray::begin() const
+{
+    return const_iterator(this, 0, position.begin());
+}
+
+Shanhj_Json::JsonArray::const_iterator Shanhj_Json::JsonArray::end() const
+{
+    return const_iterator(this, size(), position.end());
+}
+
+void Shanhj_Json::JsonArray::visit(JsonVisitor &visitor) const
+{
+    if (visitor.array_begin(*this))
+    {
+        ulong index = 0;
+        for (auto value : *this)
+        {
+            visitor.index(index++);
+            value.visit(visitor);
+        }
+    }
+    visitor.array_end(*this);
+}
+
+std::string Shanhj_Json::JsonArray::output_to_string(long indent) const
+{
+    if (output_cache) return cached_output(indent)->text;
+    string result;
+    output(result, indent, false);
+    return result;
+}
+
+std::string Shanhj_Json::JsonArray::output_parallel(long indent, ulong threads) const
+{
+    if (output_cache) // 缓存有效时直接返回，否则并行生成，根节点不生成缓存
+    {
+        auto text = atomic_load(&cache.text);
+        if (text && text->indent == indent) return text->text;
+    }
+    return ParallelOutput::output(*this, indent, threads);
+}
+
+void Shanhj_Json::JsonArray::set_output_cache(bool enable)
+{
+    output_cache = enable;
+    if (!enable) drop_cache();
+}
+
+std::shared_ptr<const Shanhj_Json::output_text> Shanhj_Json::JsonArray::cached_output(long indent) const
+{
+    auto text = atomic_load(&cache.text);
+    if (!text || text->indent != indent)
+    {
+        auto fresh = make_shared<output_text>();
+        fresh->indent = indent;
+        output(fresh->text, indent, true);
+        text = std::move(fresh);
+        atomic_store(&cache.text, text);
+    }
+    return text;
+}
+
+void Shanhj_Json::JsonArray::drop_cache()
+{
+    atomic_store(&cache.text, shared_ptr<const output_text>());
+    for (auto &object : v_object) // 共享的子树可能正在被其他文档使用，不释放
+    {
+        if (object.use_count() == 1) object->drop_cache();
+    }
+    for (auto &array : v_array)
+    {
+        if (array.use_count() == 1) array->drop_cache();
+    }
+}
+
+void Shanhj_Json::JsonArray::modified()
+{
+    atomic_store(&cache.text, shared_ptr<const output_text>());
+    hash_value.value.store(0, memory_order_relaxed);
+}
+
+uint64_t Shanhj_Json::JsonArray::hash() const
+{
+    uint64_t value = hash_value.value.load(memory_order_relaxed);
+    if (value) return value;
+    value = JsonPatch::hash(*this);
+    hash_value.value.store(value, memory_order_relaxed);
+    return value;
+}
+
+bool Shanhj_Json::JsonArray::operator==(const JsonArray &other) const
+{
+    return this == &other || (!JsonPatch::hash_differs(*this, other) && JsonPatch::equal(*this, other));
+}
+
+bool Shanhj_Json::JsonArray::operator!=(const JsonArray &other) const
+{
+    return !(*this == other);
+}
+
+void Shanhj_Json::JsonArray::output(string &result, long indent, bool cached) const
+{
+    output_begin(result, indent);
+    if (packed != TYPE_NULL)
+        output_packed(result, 0, size(), true, indent);
+    else
+        output_elements(result, position.begin(), position.end(), true, indent, cached);
+    output_end(result, indent);
+}
+
+void Shanhj_Json::JsonArray::output_begin(string &result, long indent) const
+{
+    result += '[';
+    if (size() && indent >= 0)
+    {
+        result += '\n';
+        for (int i = 0; i < indent + 4; i++) // 缩进
+            result += ' ';
+    }
+}
+
+void Shanhj_Json::JsonArray::output_end(string &result, long indent) const
+{
+    if (size() && indent >= 0)
+    {
+        result += '\n';
+        for (int i = 0; i < indent; i++)
+            result += ' ';
+    }
+    result += "]";
+}
+
+void Shanhj_Json::JsonArray::output_separator(string &result, bool first, long indent)
+{
+    if (first) return;
+    result += ',';
+    if (indent >= 0)
+    {
+        result += '\n';
+        for (int i = 0; i < indent + 4; i++) // 缩进
+            result += ' ';
+    }
+}
+
+void Shanhj_Json::JsonArray::output_elements(string &result, element_iterator begin, element_iterator end, bool first,
+                                             long indent, bool cached) const
+{
+    for (auto iter = begin; iter != end; iter++, first = false)
+    {
+        output_separator(result, first, indent);
+        switch (iter->first)
+        {
+        case TYPE_STRING:
+            result += '\"';
+            result += binary_to_text(v_string[iter->second]);
+            result += '\"';
+            break;
+        case TYPE_BOOLEAN:
+            result += iter->second ? "true" : "false";
+            break;
+        case TYPE_INT:
+            result += to_string(v_int[iter->second]);
+            break;
+        case TYPE_DOUBLE:
+            result += to_string(v_double[iter->second]);
+            break;
+        case TYPE_NUMBER:
+            result.append(number_text, v_number[iter->second].offset, v_number[iter->second].length);
+            break;
+        case TYPE_OBJECT:
+            if (cached)
+                result += v_object[iter->second]->cached_output(indent >= 0 ? indent + 4 : -1)->text;
+            else
+                v_object[iter->second]->output(result, indent >= 0 ? indent + 4 : -1, false);
+            break;
+        case TYPE_ARRAY:
+            if (cached)
+                result += v_array[iter->second]->cached_output(indent >= 0 ? indent + 4 : -1)->text;
+            else
+                v_array[iter->second]->output(result, indent >= 0 ? indent + 4 : -1, false);
+            break;
+        case TYPE_NULL:
+            result += "null";
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Shanhj_Json::JsonArray::clear()
+{
+    modified();
+    position.clear();
+    packed = TYPE_NULL;
+    v_boolean.clear();
+    int_mark.clear();
+    v_array.clear();
+    v_double.clear();
+    v_int.clear();
+    v_number.clear();
+    number_text.clear();
+    v_object.clear();
+    v_string.clear();
+}
+
+char *Shanhj_Json::JsonArray::parser_from_array(char *array_begin, char *array_end, bool &result,
+                                                const parse_limits &limits)
+{
+    Parser parser(limits);
+    return parser.parse(array_begin, array_end, *this, result);
+}
+
+char *Shanhj_Json::JsonArray::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                const parse_limits &limits)
+{
+    Parser parser(limits);
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+char *Shanhj_Json::JsonArray::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                const JsonSchema &schema, const parse_limits &limits)
+{
+    Parser parser(limits);
+    parser.schema = &schema;
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+char *Shanhj_Json::JsonArray::parser_from_array(char *array_begin, char *array_end, bool &result, parse_error &error,
+                                                const JsonProjection &projection, const parse_limits &limits)
+{
+    Parser parser(limits);
+    parser.projection = &projection;
+    auto end_pos = parser.parse(array_begin, array_end, *this, result);
+    error = parser.last_error();
+    return end_pos;
+}
+
+Shanhj_Json::ulong Shanhj_Json::JsonArray::size() const
+{
+    switch (packed)
+    {
+    case TYPE_STRING:
+        return v_string.size();
+    case TYPE_INT:
+        return v_int.size();
+    case TYPE_DOUBLE:
+        return v_double.size();
+    case TYPE_BOOLEAN:
+        return v_boolean.size();
+    default:
+        return position.size();
+    }
+}
+
+bool Shanhj_Json::JsonArray::remove(ulong index)
+{
+    if (index >= size()) return false;
+    modified();
+    switch (packed) // 压缩形式直接移除对应的值，后面的元素整体前移
+    {
+    case TYPE_STRING:
+        v_string.erase(v_string.begin() + index);
+        return true;
+    case TYPE_INT:
+        v_int.erase(v_int.begin() + index);
+        return true;
+    case TYPE_DOUBLE:
+        v_double.erase(v_double.begin() + index);
+        if (!int_mark.empty())
+        {
+            int_mark.erase(int_mark.begin() + index);
+            v_int.erase(v_int.begin() + index);
+        }
+        return true;
+    case TYPE_BOOLEAN:
+        v_boolean.erase(v_boolean.begin() + index);
+        return true;
+    default:
+        break;
+    }
+    auto iter = position.begin();
+    while (index--)
+        iter++;
+    position.erase(iter);
+    return true;
+}
+
+bool Shanhj_Json::JsonArray::apply_patch(const JsonArray &patch)
+{
+    return JsonPatch::apply(nullptr, this, patch);
+}
+
+void Shanhj_Json::JsonArray::extract(vector<JsonColumn> &columns) const
+{
+    for (auto &column : columns)
+        column.reset();
+    if (packed != TYPE_NULL) // 压缩形式的数组中没有对象，每一行都无效
+    {
+        for (ulong row = size(); row > 0; row--)
+            for (auto &column : columns)
+                column.add_row();
+        return;
+    }
+    for (auto &item : position)
+    {
+        for (auto &column : columns)
+            column.add_row();
+        if (item.first != TYPE_OBJECT) continue;
+        const JsonObject &object = *v_object[item.second];
+        for (auto &column : columns)
+        {
+            auto iter = object.position.find(column.name);
+            if (iter == object.position.end()) continue;
+            auto &value = iter->second;
+            if (column.type == TYPE_INT && value.first == TYPE_INT)
+                column.ints.back() = object.v_int[value.second];
+            else if (column.type == TYPE_INT && value.first == TYPE_NUMBER)
+            {
+                if (!raw_to_int(object.number_text, object.v_number[value.second], column.ints.back())) continue;
+            }
+            else if (column.type == TYPE_DOUBLE && value.first == TYPE_INT)
+                column.doubles.back() = object.v_int[value.second];
+            else if (column.type == TYPE_DOUBLE && value.first == TYPE_DOUBLE)
+                column.doubles.back() = object.v_double[value.second];
+            else if (column.type == TYPE_DOUBLE && value.first == TYPE_NUMBER)
+            {
+                int64_t int_value;
+                auto &number = object.v_number[value.second];
+                if (raw_to_int(object.number_text, number, int_value))
+                    column.doubles.back() = int_value;
+                else
+                    raw_to_double(object.number_text, number, column.doubles.back());
+            }
+            else if (column.type == TYPE_BOOLEAN && value.first == TYPE_BOOLEAN)
+                column.booleans.back() = value.second;
+            else if (column.type == TYPE_STRING && value.first == TYPE_STRING)
+            {
+                column.chars += object.v_string[value.second];
+                column.offsets.back() = column.chars.size();
+            }
+            else
+                continue;
+            column.mark(true);
+        }
+    }
+}
+
+bool Shanhj_Json::JsonArray::get_ints(typed_span<int64_t> &result) const
+{
+    if (packed != TYPE_INT && size()) return false;
+    result = typed_span<int64_t>(v_int.data(), packed == TYPE_INT ? v_int.size() : 0);
+    return true;
+}
+
+bool Shanhj_Json::JsonArray::get_doubles(typed_span<double> &result) const
+{
+    if (packed != TYPE_DOUBLE && size()) return false;
+    result = typed_span<double>(v_double.data(), packed == TYPE_DOUBLE ? v_double.size() : 0);
+    return true;
+}
+
+void Shanhj_Json::JsonArray::assign(typed_span<int64_t> values)
+{
+    vector<int64_t> copy(values.begin(), values.end()); // values可能指向当前数组
+    clear();
+    packed = TYPE_INT;
+    v_int.swap(copy);
+}
+
+void Shanhj_Json::JsonArray::assign(typed_span<double> values)
+{
+    vector<double> copy(values.begin(), values.end());
+    clear();
+    packed = TYPE_DOUBLE;
+    v_double.swap(copy);
+}
+
+bool Shanhj_Json::JsonArray::append_number(int64_t int_value, double double_value, bool is_double)
+{
+    const int64_t exact = 1LL << 53; // 绝对值不超过2^53的整数转换为浮点数没有误差
+    if (packed == TYPE_INT && !is_double)
+    {
+        v_int.push_back(int_value);
+        return true;
+    }
+    if (packed == TYPE_INT) // 整数组中放入浮点数，所有整数都能精确转换时整体转换为浮点数组
+    {
+        for (int64_t value : v_int)
+        {
+            if (value > exact || value < -exact)
+            {
+                unpack();
+                return false;
+            }
+        }
+        v_double.assign(v_int.begin(), v_int.end());
+        int_mark.assign(v_int.size(), 1);
+        packed = TYPE_DOUBLE;
+    }
+    if (packed == TYPE_DOUBLE)
+    {
+        if (!is_double && (int_value > exact || int_value < -exact))
+        {
+            unpack();
+            return false;
+        }
+        if (!is_double && int_mark.empty())
+        {
+            int_mark.assign(v_double.size(), 0);
+            v_int.assign(v_double.size(), 0);
+        }
+        v_double.push_back(is_double ? double_value : (double)int_value);
+        if (!int_mark.empty())
+        {
+            int_mark.push_back(!is_double);
+            v_int.push_back(is_double ? 0 : int_value);
+        }
+        return true;
+    }
+    if (!append_packed(is_double ? TYPE_DOUBLE : TYPE_INT, 0)) return false;
+    if (is_double)
+        v_double.push_back(double_value);
+    else
+        v_int.push_back(int_value);
+    return true;
+}
+
+bool Shanhj_Json::JsonArray::append_packed(value_type type, ulong value)
+{
+    if (packed != TYPE_NULL && packed == type)
+    {
+        if (type == TYPE_BOOLEAN) v_boolean.push_back(value);
+        return true;
+    }
+    bool packable = type == TYPE_STRING || type == TYPE_INT || type == TYPE_DOUBLE || type == TYPE_BOOLEAN;
+    if (packable && size() == 0)
+    {
+        // 数组为空时各个vector中只可能剩下被移除的元素留下的值，清空后第i个元素就是第i个值
+        position.clear();
+        v_string.clear();
+        v_int.clear();
+        v_double.clear();
+        v_number.clear();
+        number_text.clear();
+        v_object.clear();
+        v_array.clear();
+        v_boolean.clear();
+        int_mark.clear();
+        packed = type;
+        if (type == TYPE_BOOLEAN) v_boolean.push_back(value);
+        return true;
+    }
+    unpack();
+    return false;
+}
+
+void Shanhj_Json::JsonArray::unpack()
+{
+    if (packed == TYPE_NULL) return;
+    for (ulong i = 0, count = size(); i < count; i++)
+        position.push_back(entry_at(i));
+    packed = TYPE_NULL;
+    v_boolean.clear();
+    int_mark.clear(); // 整数仍在v_int中，position中记录了它们的位置
+}
+
+std::pair<Shanhj_Json::value_type, Shanhj_Json::ulong> Shanhj_Json::JsonArray::entry_at(ulong index) const
+{
+    if (packed == TYPE_BOOLEAN) return {TYPE_BOOLEAN, v_boolean[index]};
+    if (packed == TYPE_DOUBLE && !int_mark.empty() && int_mark[index]) return {TYPE_INT, index};
+    if (packed != TYPE_NULL) return {packed, index};
+    auto iter = position.begin();
+    while (index--)
+        iter++;
+    return *iter;
+}
+
+template <typename F>
+void Shanhj_Json::JsonArray::for_each_entry(F f) const
+{
+    if (packed == TYPE_NULL)
+    {
+        for (auto &item : position)
+            f(item);
+        return;
+    }
+    for (ulong i = 0, count = size(); i < count; i++)
+        f(entry_at(i));
+}
+
+std::vector<std::pair<Shanhj_Json::value_type, Shanhj_Json::ulong>> Shanhj_Json::JsonArray::entries() const
+{
+    vector<pair<value_type, ulong>> result;
+    result.reserve(size());
+    for_each_entry([&](const pair<value_type, ulong> &item) { result.push_back(item); });
+    return result;
+}
+
+void Shanhj_Json::JsonArray::output_packed(string &result, ulong begin, ulong end, bool first, long indent) const
+{
+    string separator = indent >= 0 ? ",\n" + string(indent + 4, ' ') : ",";
+    switch (packed)
+    {
+    case TYPE_STRING:
+        for (ulong i = begin; i < end; i++)
+        {
+            if (i != begin || !first) result += separator;
+            result += '\"';
+            result += binary_to_text(v_string[i]);
+            result += '\"';
+        }
+        break;
+    case TYPE_INT: // 转换到栈上的缓冲区，不为每个数字分配string，结果与to_string相同
+    {
+        char buffer[24];
+        for (ulong i = begin; i < end; i++)
+        {
+            if (i != begin || !first) result += separator;
+            result.append(buffer, to_chars(buffer, buffer + sizeof(buffer), v_int[i]).ptr);
+        }
+        break;
+    }
+    case TYPE_DOUBLE:
+    {
+        char buffer[512]; // "%f"格式最长约为310个字符
+        for (ulong i = begin; i < end; i++)
+        {
+            if (i != begin || !first) result += separator;
+            if (!int_mark.empty() && int_mark[i]) // 由整数放入的元素仍按整数输出
+                result.append(buffer, to_chars(buffer, buffer + sizeof(buffer), v_int[i]).ptr);
+            else
+                result.append(buffer, snprintf(buffer, sizeof(buffer), "%f", v_double[i]));
+        }
+        break;
+    }
+    case TYPE_BOOLEAN:
+        for (ulong i = begin; i < end; i++)
+        {
+            if (i != begin || !first) result += separator;
+            result += v_boolean[i] ? "true" : "false";
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+Shanhj_Json::JsonValue::JsonValue(const JsonObject *object, const JsonArray *array, pair<value_type, ulong> entry)
+    : object(object), array(array), entry(entry)
+{
+}
+
+Shanhj_Json::value_type Shanhj_Json::JsonValue::type() const
+{
+    return entry.first;
+}
+
+bool Shanhj_Json::JsonValue::get_string(string_view &result) const
+{
+    if (entry.first != TYPE_STRING) return false;
+    result = object ? object->v_string[entry.second] : array->v_string[entry.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonValue::get_boolean(bool &result) const
+{
+    if (entry.first != TYPE_BOOLEAN) return false;
+    result = entry.second;
+    return true;
+}
+
+bool Shanhj_Json::JsonValue::get_int(int64_t &result) const
+{
+    if (entry.first == TYPE_NUMBER)
+        return object ? raw_to_int(object->number_text, object->v_number[entry.second], result)
+                      : raw_to_int(array->number_text, array->v_number[entry.second], result);
+    if (entry.first != TYPE_INT) return false;
+    result = object ? object->v_int[entry.second] : array->v_int[entry.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonValue::get_double(double &result) const
+{
+    if (entry.first == TYPE_NUMBER)
+        return object ? raw_to_double(object->number_text, object->v_number[entry.second], result)
+                      : raw_to_double(array->number_text, array->v_number[entry.second], result);
+    if (entry.first != TYPE_DOUBLE) return false;
+    result = object ? object->v_double[entry.second] : array->v_double[entry.second];
+    return true;
+}
+
+bool Shanhj_Json::JsonValue::get_object(const JsonObject *&result) const
+{
+    if (entry.first != TYPE_OBJECT) return false;
+    result = object ? object->v_object[entry.second].get() : array->v_object[entry.second].get();
+    return true;
+}
+
+bool Shanhj_Json::JsonValue::get_array(const JsonArray *&result) const
+{
+    if (entry.first != TYPE_ARRAY) return false;
+    result = object ? object->v_array[entry.second].get() : array->v_array[entry.second].get();
+    return true;
+}
+
+void Shanhj_Json::JsonValue::visit(JsonVisitor &visitor) const
+{
+    switch (entry.first)
+    {
+    case TYPE_STRING:
+        visitor.string_value(object ? object->v_string[entry.second] : array->v_string[entry.second]);
+        break;
+    case TYPE_INT:
+        visitor.int_value(object ? object->v_int[entry.second] : array->v_int[entry.second]);
+        break;
+    case TYPE_DOUBLE:
+        visitor.double_value(object ? object->v_double[entry.second] : array->v_double[entry.second]);
+        break;
+    case TYPE_NUMBER:
+        visitor.number_value(*this);
+        break;
+    case TYPE_BOOLEAN:
+        visitor.boolean_value(entry.second);
+        break;
+    case TYPE_OBJECT:
+        (object ? object->v_object[entry.second] : array->v_object[entry.second])->visit(visitor);
+        break;
+    case TYPE_ARRAY:
+        (object ? object->v_array[entry.second] : array->v_array[entry.second])->visit(visitor);
+        break;
+    default:
+        visitor.null_value();
+        break;
+    }
+}
+
+void Shanhj_Json::JsonVisitor::number_value(const JsonValue &value)
+{
+    int64_t integer;
+    double real;
+    if (value.get_int(integer))
+        int_value(integer);
+    else if (value.get_double(real))
+        double_value(real);
+}
+
+Shanhj_Json::PaddedBuffer::PaddedBuffer(ulong size) : buffer(new char[size + input_padding]), length(size)
+{
+    memset(buffer.get() + size, 0, input_padding);
+}
+
+Shanhj_Json::PaddedBuffer::PaddedBuffer(const char *data, ulong size) : PaddedBuffer(size)
+{
+    memcpy(buffer.get(), data, size);
+}
+
+Shanhj_Json::PaddedBuffer::PaddedBuffer(const string &text) : PaddedBuffer(text.data(), text.size())
+{
+}
+
+bool Shanhj_Json::PaddedBuffer::load(const string &path)
+{
+    *this = PaddedBuffer();
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    bool loaded = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (loaded)
+    {
+        *this = PaddedBuffer((ulong)size);
+        loaded = fread(buffer.get(), 1, size, file) == (ulong)size;
+    }
+    fclose(file);
+    if (!loaded) *this = PaddedBuffer();
+    return loaded;
+}
+
+char *Shanhj_Json::PaddedBuffer::data()
+{
+    return buffer.get();
+}
+
+const char *Shanhj_Json::PaddedBuffer::data() const
+{
+    return buffer.get();
+}
+
+Shanhj_Json::ulong Shanhj_Json::PaddedBuffer::size() const
+{
+    return length;
+}
+
+Shanhj_Json::Parser::Parser(const parse_limits &limits) : limits(limits)
+{
+}
+
+char *Shanhj_Json::Parser::parse(char *array_begin, char *array_end, JsonObject &target, bool &result)
+{
+    recycle(target);
+    return parse_root<false>(array_begin, array_end, {true, &target}, result);
+}
+
+char *Shanhj_Json::Parser::parse(char *array_begin, char *array_end, JsonArray &target, bool &result)
+{
+    recycle(target);
+    return parse_root<false>(array_begin, array_end, {false, nullptr, &target}, result);
+}
+
+char *Shanhj_Json::Parser::parse(PaddedBuffer &input, JsonObject &target, bool &result)
+{
+    recycle(target);
+    return parse_root<true>(input.data(), input.data() + input.size(), {true, &target}, result);
+}
+
+char *Shanhj_Json::Parser::parse(PaddedBuffer &input, JsonArray &target, bool &result)
+{
+    recycle(target);
+    return parse_root<true>(input.data(), input.data() + input.size(), {false, nullptr, &target}, result);
+}
+
+const Shanhj_Json::parse_error &Shanhj_Json::Parser::last_error() const
+{
+    return error;
+}
+
+char *Shanhj_Json::Parser::fail(char *position, error_code code, const char *expected, bool &result)
+{
+    if (position >= document_end) code = ERROR_TRUNCATED;
+    error.code = code;
+    error.expected = expected;
+    error.offset = position - document_begin;
+    locate_position(document_begin, position, error.line, error.column);
+    result = false;
+    return position;
+}
+
+bool Shanhj_Json::Parser::open_document(char *&array_begin, char *array_end, char open, bool &result)
+{
+    const char *expected = open == '{' ? "'{'" : open == '[' ? "'['" : "'{' or '['";
+    document_begin = array_begin;
+    document_end = array_end;
+    error.code = ERROR_NONE;
+    if (array_begin >= array_end)
+        array_begin = fail(array_begin, ERROR_TRUNCATED, expected, result);
+    else if ((ulong)(array_end - array_begin) > limits.max_document_size)
+        array_begin = fail(array_begin, ERROR_LIMIT_EXCEEDED, "", result);
+    else if (!skip_space(array_begin, array_end) || (open ? *array_begin != open : *array_begin != '{' && *array_begin != '['))
+        array_begin = fail(array_begin, ERROR_UNEXPECTED_TOKEN, expected, result);
+    else if (limits.max_depth == 0)
+        array_begin = fail(array_begin, ERROR_DEPTH_EXCEEDED, "", result);
+    else if (limits.max_nodes == 0)
+        array_begin = fail(array_begin, ERROR_LIMIT_EXCEEDED, "", result);
+    else
+        return true;
+    return false;
+}
+
+template <bool padded>
+char *Shanhj_Json::Parser::parse_root(char *array_begin, char *array_end, frame root, bool &result)
+{
+    if (!open_document(array_begin, array_end, root.is_object ? '{' : '[', result)) return array_begin;
+    if (schema) // 根节点对应schema的第0个节点
+    {
+        const char *violation = schema->nodes.empty() ? "schema" : schema->check_container(0, root.is_object ? TYPE_OBJECT : TYPE_ARRAY);
+        if (violation) return fail(array_begin, ERROR_SCHEMA, violation, result);
+        root.schema = 0;
+    }
+    if (projection) root.mask = projection->whole ? -1 : 0;
+    stack.assign(1, root);
+    node_count = 1;
+    build_sink sink{*this};
+    return tokenize<padded>(array_begin + 1, array_end, sink, result);
+}
+
+template <bool padded, typename Sink>
+char *Shanhj_Json::Parser::tokenize(char *array_begin, char *array_end, Sink &sink, bool &result)
+{
+    while (true)
+    {
+        frame &top = stack.back();
+        if (!skip_space<padded>(array_begin, array_end))
+            return fail(array_begin, ERROR_TRUNCATED, top.is_object ? "'}'" : "']'", result);
+        if (top.value_order && *array_begin == ',') // 前面已经有值，需要逗号分隔
+        {
+            array_begin++;
+            if (!skip_space<padded>(array_begin, array_end))
+                return fail(array_begin, ERROR_TRUNCATED, top.is_object ? "'\"'" : "value", result);
+        }
+        else if (*array_begin == (top.is_object ? '}' : ']')) // 当前容器结束，回到上一层
+        {
+            if (top.schema >= 0)
+            {
+                const char *violation = schema->check_end(top.schema, top.is_object, top.value_order, top.seen);
+                if (violation) return fail(array_begin, ERROR_SCHEMA, violation, result);
+            }
+            sink.close(top);
+            array_begin++;
+            stack.pop_back();
+            if (stack.empty())
+            {
+                result = true;
+                return array_begin;
+            }
+            continue;
+        }
+        else if (top.value_order)
+            return fail(array_begin, ERROR_UNEXPECTED_TOKEN, top.is_object ? "',' or '}'" : "',' or ']'", result);
+
+        sink.member(top);
+        if (top.is_object) // 获取键值，只在需要时转义
+        {
+            if (*array_begin != '\"')
+                return fail(array_begin, ERROR_UNEXPECTED_TOKEN, top.value_order ? "'\"'" : "'\"' or '}'", result);
+            char *key_begin = array_begin;
+            array_begin++;
+            if (top.schema >= 0 || top.mask >= 0 || sink.wants_key(top))
+            {
+                key.clear();
+                if (!get_binary_from_text<padded>(array_begin, array_end, key))
+                    return fail(array_begin, ERROR_BAD_ESCAPE, "escape character", result);
+                if (key.size() > limits.max_string_length)
+                    return fail(key_begin, ERROR_LIMIT_EXCEEDED, "", result);
+            }
+            else
+            {
+                if (!skip_string(array_begin, array_end))
+                    return fail(array_begin, ERROR_BAD_ESCAPE, "escape character", result);
+                if ((ulong)(array_begin - key_begin - 2) > limits.max_string_length)
+                    return fail(key_begin, ERROR_LIMIT_EXCEEDED, "", result);
+            }
+            char *key_end = array_begin;
+            if (!skip_space<padded>(array_begin, array_end) || *array_begin != ':')
+                return fail(array_begin, ERROR_UNEXPECTED_TOKEN, "':'", result);
+            array_begin++;
+            if (!skip_space<padded>(array_begin, array_end))
+                return fail(array_begin, ERROR_TRUNCATED, "value", result);
+            sink.key(top, key_begin, key_end);
+        }
+
+        // 获取值
+        if (++node_count > limits.max_nodes)
+            return fail(array_begin, ERROR_LIMIT_EXCEEDED, "", result);
+        top.value_order++;
+        long rule = -1; // 当前值对应的schema节点
+        if (top.schema >= 0)
+        {
+            if (top.is_object)
+                rule = schema->property(top.schema, key, top.seen);
+            else if (top.value_order > schema->nodes[top.schema].max_items)
+                return fail(array_begin, ERROR_SCHEMA, "maxItems", result);
+            else
+                rule = schema->nodes[top.schema].items;
+        }
+        long mask = top.mask; // 当前值对应的投影节点，数组的元素沿用数组的投影
+        bool keep = top.keep; // 是否构造当前值，投影没有选中的成员只校验，不构造，但仍然按schema检查
+        if (mask >= 0 && top.is_object && !projection->select(top.mask, key, mask))
+        {
+            keep = false;
+            mask = -1;
+        }
+        const char *violation = nullptr;
+        char *value_begin = array_begin;
+        switch (classify_char(*array_begin))
+        {
+        case CLASS_STRING: // 字符串类型，sink不需要内容并且没有schema时只校验转义字符
+        {
+            array_begin++;
+            string *text = sink.string_target(top, keep, rule);
+            if (text)
+            {
+                ulong text_begin = text->size();
+                if (!get_binary_from_text<padded>(array_begin, array_end, *text))
+                    return fail(array_begin, ERROR_BAD_ESCAPE, "escape character", result);
+                if (text->size() - text_begin > limits.max_string_length)
+                    return fail(value_begin, ERROR_LIMIT_EXCEEDED, "", result);
+                if (rule >= 0 && (violation = schema->check_string(rule, *text)))
+                    return fail(value_begin, ERROR_SCHEMA, violation, result);
+            }
+            else
+            {
+                if (!skip_string(array_begin, array_end))
+                    return fail(array_begin, ERROR_BAD_ESCAPE, "escape character", result);
+                if ((ulong)(array_begin - value_begin - 2) > limits.max_string_length)
+                    return fail(value_begin, ERROR_LIMIT_EXCEEDED, "", result);
+            }
+            sink.string_value(top, keep, value_begin, array_begin);
+            break;
+        }
+        case CLASS_TRUE: // 字面量true、false和null
+        case CLASS_FALSE:
+        case CLASS_NULL:
+        {
+            value_type type = *array_begin == 'n' ? TYPE_NULL : TYPE_BOOLEAN;
+            bool value = *array_begin == 't';
+            const char *literal = type == TYPE_NULL ? "null" : value ? "true" : "false";
+            ulong length = *array_begin == 'f' ? 5 : 4;
+            if (!match_literal<padded>(array_begin, array_end, literal, length))
+                return fail(literal_mismatch(array_begin, array_end, literal, length), ERROR_UNEXPECTED_TOKEN, literal, result);
+            if (rule >= 0 && (violation = schema->check_literal(rule, type, value)))
+                return fail(array_begin, ERROR_SCHEMA, violation, result);
+            sink.literal(top, keep, type, value, array_begin, length);
+            array_begin += length;
+            break;
+        }
+        case CLASS_OBJECT: // json对象或数组，入栈后继续解析其中的值
+        case CLASS_ARRAY:
+        {
+            frame child = {*array_begin == '{'};
+            if (stack.size() >= limits.max_depth)
+                return fail(array_begin, ERROR_DEPTH_EXCEEDED, "", result);
+            if (rule >= 0 && (violation = schema->check_container(rule, child.is_object ? TYPE_OBJECT : TYPE_ARRAY)))
+                return fail(array_begin, ERROR_SCHEMA, violation, result);
+            child.keep = keep;
+            child.schema = rule;
+            child.mask = mask;
+            sink.open(top, child);
+            stack.push_back(child); // 入栈后top失效
+            array_begin++;
+            break;
+        }
+        case CLASS_NUMBER: // 数字类型，schema按数字的原文检查
+            if (!sink.template number<padded>(top, keep, array_begin, array_end))
+                return fail(array_begin, ERROR_BAD_NUMBER, "digit", result);
+            if (rule >= 0 && (violation = schema->check_number(rule, value_begin, array_begin)))
+                return fail(value_begin, ERROR_SCHEMA, violation, result);
+            break;
+        default:
+            return fail(array_begin, ERROR_UNEXPECTED_TOKEN, "value", result);
+        }
+    }
+}
+
+bool Shanhj_Json::Parser::build_sink::wants_key(const frame &top) const
+{
+    return top.keep;
+}
+
+void Shanhj_Json::Parser::build_sink::member(const frame &)
+{
+}
+
+void Shanhj_Json::Parser::build_sink::key(const frame &, const char *, const char *)
+{
+}
+
+std::string *Shanhj_Json::Parser::build_sink::string_target(const frame &, bool keep, long rule)
+{
+    if (!keep) // 不构造的字符串只在需要按schema检查时转义，用完即丢弃
+    {
+        if (rule < 0) return nullptr;
+        value.clear();
+        return &value;
+    }
+    value = parser.take_string();
+    return &value;
+}
+
+void Shanhj_Json::Parser::build_sink::string_value(frame &top, bool keep, const char *, const char *)
+{
+    if (!keep) return;
+    auto &v_string = top.object ? top.object->v_string : top.array->v_string;
+    parser.add_slot(top, TYPE_STRING, v_string.size()); // 先登记位置，数组变为压缩形式时会清空存储
+    v_string.push_back(std::move(value));
+}
+
+void Shanhj_Json::Parser::build_sink::literal(frame &top, bool keep, value_type type, bool value, const char *, ulong)
+{
+    if (keep) parser.add_slot(top, type, value);
+}
+
+template <bool padded>
+bool Shanhj_Json::Parser::build_sink::number(frame &top, bool keep, char *&array, char *array_end)
+{
+    if (!keep)
+    {
+        bool is_double;
+        return scan_number<padded>(array, array_end, is_double);
+    }
+    if (parser.raw_numbers) // 只记录原文和分类
+    {
+        char *number_begin = array;
+        number_kind kind;
+        if (!classify_number<padded>(array, array_end, kind)) return false;
+        auto &v_number = top.object ? top.object->v_number : top.array->v_number;
+        auto &number_text = top.object ? top.object->number_text : top.array->number_text;
+        parser.add_slot(top, TYPE_NUMBER, v_number.size());
+        v_number.push_back({number_text.size(), (ulong)(array - number_begin), kind});
+        number_text.append(number_begin, array);
+        return true;
+    }
+    int64_t int_value;
+    double double_value;
+    bool is_double;
+    if (!parser.parse_number<padded>(array, array_end, int_value, double_value, is_double)) return false;
+    // 已经是普通形式的数组不再尝试压缩，与add_slot相同
+    if (top.array && (top.array->packed != TYPE_NULL || top.array->position.empty()) &&
+        top.array->append_number(int_value, double_value, is_double))
+        return true;
+    if (is_double)
+    {
+        auto &v_double = top.object ? top.object->v_double : top.array->v_double;
+        parser.add_slot(top, TYPE_DOUBLE, v_double.size());
+        v_double.push_back(double_value);
+    }
+    else
+    {
+        auto &v_int = top.object ? top.object->v_int : top.array->v_int;
+        parser.add_slot(top, TYPE_INT, v_int.size());
+        v_int.push_back(int_value);
+    }
+    return true;
+}
+
+void Shanhj_Json::Parser::build_sink::open(frame &top, frame &child)
+{
+    if (!child.keep) return;
+    if (child.is_object) // 先在父容器中放入一个空对象，入栈后原地构造
+    {
+        auto node = parser.take_node(parser.object_pool);
+        auto &v_object = top.object ? top.object->v_object : top.array->v_object;
+        parser.add_slot(top, TYPE_OBJECT, v_object.size());
+        v_object.push_back(node);
+        child.object = node.get();
+    }
+    else
+    {
+        auto node = parser.take_node(parser.array_pool);
+        auto &v_array = top.object ? top.object->v_array : top.array->v_array;
+        parser.add_slot(top, TYPE_ARRAY, v_array.size());
+        v_array.push_back(node);
+        child.array = node.get();
+    }
+}
+
+void Shanhj_Json::Parser::build_sink::close(const frame &)
+{
+}
+
+char *Shanhj_Json::Parser::transcode(char *array_begin, char *array_end, string &output, bool &result, long indent)
+{
+    ulong output_size = output.size();
+    if (open_document(array_begin, array_end, 0, result))
+    {
+        stack.assign(1, {*array_begin == '{'});
+        node_count = 1;
+        output += *array_begin;
+        text_sink sink{*this, output, indent};
+        array_begin = tokenize<false>(array_begin + 1, array_end, sink, result);
+    }
+    if (!result) output.resize(output_size); // 撤销出错前已经输出的部分
+    return array_begin;
+}
+
+bool Shanhj_Json::Parser::text_sink::wants_key(const frame &) const
+{
+    return false;
+}
+
+void Shanhj_Json::Parser::text_sink::member(const frame &top)
+{
+    if (top.value_order) output += ',';
+    if (indent >= 0) // 缩进
+    {
+        output += '\n';
+        output.append(indent + 4 * parser.stack.size(), ' ');
+    }
+}
+
+void Shanhj_Json::Parser::text_sink::key(const frame &, const char *begin, const char *end)
+{
+    output.append(begin, end);
+    output += indent >= 0 ? ": " : ":";
+}
+
+std::string *Shanhj_Json::Parser::text_sink::string_target(const frame &, bool, long)
+{
+    return nullptr;
+}
+
+void Shanhj_Json::Parser::text_sink::string_value(frame &, bool, const char *begin, const char *end)
+{
+    output.append(begin, end);
+}
+
+void Shanhj_Json::Parser::text_sink::literal(frame &, bool, value_type, bool, const char *begin, ulong length)
+{
+    output.append(begin, length);
+}
+
+template <bool padded>
+bool Shanhj_Json::Parser::text_sink::number(frame &, bool, char *&array, char *array_end)
+{
+    char *number_begin = array;
+    bool is_double;
+    if (!scan_number<padded>(array, array_end, is_double)) return false;
+    output.append(number_begin, array);
+    return true;
+}
+
+void Shanhj_Json::Parser::text_sink::open(frame &, frame &child)
+{
+    output += child.is_object ? '{' : '[';
+}
+
+void Shanhj_Json::Parser::text_sink::close(const frame &top)
+{
+    if (top.value_order && indent >= 0)
+    {
+        output += '\n';
+        output.append(indent + 4 * (parser.stack.size() - 1), ' ');
+    }
+    output += top.is_object ? '}' : ']';
+}
+
+char *Shanhj_Json::Parser::extract(char *array_begin, char *array_end, vector<JsonColumn> &columns, bool &result)
+{
+    for (auto &column : columns)
+        column.reset();
+    if (!open_document(array_begin, array_end, '[', result)) return array_begin;
+    stack.assign(1, {false});
+    node_count = 1;
+    column_sink sink{*this, columns};
+    return tokenize<false>(array_begin + 1, array_end, sink, result);
+}
+
+bool Shanhj_Json::Parser::column_sink::wants_key(const frame &) const
+{
+    return parser.stack.size() == 2; // 只有数组元素本身的字段才可能属于某一列
+}
+
+void Shanhj_Json::Parser::column_sink::member(const frame &)
+{
+    if (parser.stack.size() == 1) // 数组的一个元素，即新的一行
+    {
+        for (auto &column : columns)
+            column.add_row();
+    }
+}
+
+void Shanhj_Json::Parser::column_sink::key(const frame &, const char *, const char *)
+{
+    if (parser.stack.size() != 2) return;
+    field = nullptr;
+    for (auto &column : columns)
+    {
+        if (column.name == parser.key)
+        {
+            field = &column;
+            break;
+        }
+    }
+}
+
+Shanhj_Json::JsonColumn *Shanhj_Json::Parser::column_sink::take_field()
+{
+    JsonColumn *column = field;
+    field = nullptr;
+    return column;
+}
+
+std::string *Shanhj_Json::Parser::column_sink::string_target(const frame &, bool, long)
+{
+    current = take_field();
+    if (!current || current->type != TYPE_STRING) return nullptr;
+    current->chars.resize(current->offsets[current->rows - 1]); // 同一个键出现多次时以最后一次为准
+    return &current->chars;
+}
+
+void Shanhj_Json::Parser::column_sink::string_value(frame &, bool, const char *, const char *)
+{
+    if (!current) return;
+    bool stored = current->type == TYPE_STRING;
+    if (stored) current->offsets.back() = current->chars.size();
+    current->mark(stored);
+}
+
+void Shanhj_Json::Parser::column_sink::literal(frame &, bool, value_type type, bool value, const char *, ulong)
+{
+    JsonColumn *column = take_field();
+    if (!column) return;
+    bool stored = type == TYPE_BOOLEAN && column->type == TYPE_BOOLEAN;
+    if (stored) column->booleans.back() = value;
+    column->mark(stored);
+}
+
+template <bool padded>
+bool Shanhj_Json::Parser::column_sink::number(frame &, bool, char *&array, char *array_end)
+{
+    JsonColumn *column = take_field();
+    bool is_double;
+    if (!column || (column->type != TYPE_INT && column->type != TYPE_DOUBLE))
+    {
+        if (!scan_number<padded>(array, array_end, is_double)) return false;
+        if (column) column->mark(false);
+        return true;
+    }
+    int64_t int_value;
+    double double_value;
+    if (!parser.parse_number<padded>(array, array_end, int_value, double_value, is_double)) return false;
+    if (column->type == TYPE_DOUBLE)
+        column->doubles.back() = is_double ? double_value : (double)int_value;
+    else if (!is_double)
+        column->ints.back() = int_value;
+    column->mark(column->type == TYPE_DOUBLE || !is_double);
+    return true;
+}
+
+void Shanhj_Json::Parser::column_sink::open(frame &, frame &)
+{
+    JsonColumn *column = take_field();
+    if (column) column->mark(false);
+}
+
+void Shanhj_Json::Parser::column_sink::close(const frame &)
+{
+}
+
+template <bool padded>
+bool Shanhj_Json::Parser::classify_number(char *&array, char *array_end, number_kind &kind)
+{
+    char *begin = array;
+    bool is_double;
+    if (!scan_number<padded>(array, array_end, is_double)) return false;
+    if (is_double)
+    {
+        kind = NUMBER_FLOAT;
+        return true;
+    }
+    // json的整数没有前导0，位数少于19一定在int64_t范围内，等于19时与边界值逐位比较
+    bool negative = *begin == '-';
+    long digits = array - begin - negative;
+    if (digits == 19)
+        kind = memcmp(begin + negative, negative ? "9223372036854775808" : "9223372036854775807", 19) <= 0 ? NUMBER_INT64 : NUMBER_BIG_INT;
+    else
+        kind = digits < 19 ? NUMBER_INT64 : NUMBER_BIG_INT;
+    return true;
+}
+
+template <bool padded>
+bool Shanhj_Json::Parser::parse_number(char *&array, char *array_end, int64_t &int_value, double &double_value, bool &is_double)
+{
+    char *begin = array;
+    if (!scan_number<padded>(array, array_end, is_double)) return false;
+    if (!is_double)
+    {
+        bool negative = *begin == '-';
+        uint64_t value = 0;
+        bool overflow = false;
+        for (char *digit = begin + negative; digit < array; digit++)
+        {
+            uint64_t d = *digit - '0';
+            if (value > (UINT64_MAX - d) / 10)
+            {
+                overflow = true;
+                break;
+            }
+            value = value * 10 + d;
+        }
+        if (!overflow && value <= (uint64_t)INT64_MAX + negative)
+        {
+            int_value = negative ? (int64_t)(0 - value) : (int64_t)value;
+            return true;
+        }
+        is_double = true; // 超出int64_t范围
+    }
+    num.assign(begin, array);
+    double_value = strtod(num.c_str(), nullptr);
+    return true;
+}
+
+std::pair<Shanhj_Json::value_type, Shanhj_Json::ulong> &Shanhj_Json::Parser::next_slot(frame &top)
+{
+    if (top.array)
+    {
+        if (entry_pool.empty()) return top.array->position.emplace_back();
+        top.array->position.splice(top.array->position.end(), entry_pool, entry_pool.begin());
+        return top.array->position.back();
+    }
+    if (key_pool.empty()) return top.object->position[key];
+    auto node = std::move(key_pool.back());
+    key_pool.pop_back();
+    node.key() = key; // 复用节点中字符串的空间
+    auto inserted = top.object->position.insert(std::move(node));
+    if (!inserted.inserted) key_pool.push_back(std::move(inserted.node)); // 键值重复，覆盖原来的值
+    return inserted.position->second;
+}
+
+void Shanhj_Json::Parser::add_slot(frame &top, value_type type, ulong index)
+{
+    // 同类型的元素直接追加到压缩形式的数组，已经是普通形式的数组不再尝试压缩
+    if (top.array && (top.array->packed != TYPE_NULL || top.array->position.empty()) && top.array->append_packed(type, index))
+        return;
+    next_slot(top) = {type, index};
+}
+
+std::string Shanhj_Json::Parser::take_string()
+{
+    if (string_pool.empty()) return string();
+    string value = std::move(string_pool.back());
+    string_pool.pop_back();
+    value.clear();
+    return value;
+}
+
+template <typename T>
+std::shared_ptr<T> Shanhj_Json::Parser::take_node(vector<shared_ptr<T>> &pool)
+{
+    if (pool.empty()) return make_shared<T>();
+    auto node = std::move(pool.back());
+    pool.pop_back();
+    return node;
+}
+
+void Shanhj_Json::Parser::recycle(JsonObject &target)
+{
+    recycle_nodes({true, &target});
+}
+
+void Shanhj_Json::Parser::recycle(JsonArray &target)
+{
+    recycle_nodes({false, nullptr, &target});
+}
+
+void Shanhj_Json::Parser::release_pools()
+{
+    vector<shared_ptr<JsonObject>>().swap(object_pool);
+    vector<shared_ptr<JsonArray>>().swap(array_pool);
+    vector<string>().swap(string_pool);
+    vector<map<string, pair<value_type, ulong>>::node_type>().swap(key_pool);
+    entry_pool.clear();
+}
+
+void Shanhj_Json::Parser::recycle_nodes(frame root)
+{
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        frame top = stack.back();
+        stack.pop_back();
+        if (top.object)
+        {
+            auto &position = top.object->position;
+            while (!position.empty())
+                key_pool.push_back(position.extract(position.begin()));
+            recycle_storage(*top.object);
+        }
+        else
+        {
+            entry_pool.splice(entry_pool.end(), top.array->position);
+            top.array->packed = TYPE_NULL;
+            top.array->v_boolean.clear();
+            top.array->int_mark.clear();
+            recycle_storage(*top.array);
+        }
+    }
+}
+
+template <typename Container>
+void Shanhj_Json::Parser::recycle_storage(Container &container)
+{
+    // vector的clear不会释放空间，容器下次被使用时可以直接放入新的值
+    container.modified();
+    for (auto &value : container.v_string)
+        string_pool.push_back(std::move(value));
+    container.v_string.clear();
+    container.v_number.clear();
+    container.number_text.clear();
+    container.v_int.clear();
+    container.v_double.clear();
+    for (auto &child : container.v_object)
+    {
+        if (child.use_count() != 1) continue; // 与其他文档共享的子树不能回收
+        child->output_cache = false; // 池中的节点之后会用在别的文档中，不能保留原来的设置
+        stack.push_back({true, child.get()});
+        object_pool.push_back(std::move(child));
+    }
+    container.v_object.clear();
+    for (auto &child : container.v_array)
+    {
+        if (child.use_count() != 1) continue;
+        child->output_cache = false;
+        stack.push_back({false, nullptr, child.get()});
+        array_pool.push_back(std::move(child));
+    }
+    container.v_array.clear();
+}
+
+Shanhj_Json::JsonArray Shanhj_Json::JsonPatch::diff(const JsonObject &a, const JsonObject &b)
+{
+    JsonArray patch;
+    diff_object(a, b, "", patch);
+    return patch;
+}
+
+Shanhj_Json::JsonArray Shanhj_Json::JsonPatch::diff(const JsonArray &a, const JsonArray &b)
+{
+    JsonArray patch;
+    diff_array(a, b, "", patch);
+    return patch;
+}
+
+bool Shanhj_Json::JsonPatch::apply(JsonObject *object, JsonArray *array, const JsonArray &patch)
+{
+    if (patch.packed != TYPE_NULL) return patch.size() == 0; // 压缩形式的数组中不会有操作对象
+    journal log;
+    for (auto &item : patch.position)
+    {
+        if (item.first != TYPE_OBJECT || !apply_op(object, array, *patch.v_object[item.second], log))
+        {
+            // 按相反的顺序撤销此前的修改，文档恢复为执行patch之前的内容
+            for (auto iter = log.undo.rbegin(); iter != log.undo.rend(); iter++)
+                (*iter)();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Shanhj_Json::JsonPatch::apply_op(JsonObject *object, JsonArray *array, const JsonObject &op, journal &log)
+{
+    auto op_iter = op.position.find("op");
+    auto path_iter = op.position.find("path");
+    if (op_iter == op.position.end() || op_iter->second.first != TYPE_STRING ||
+        path_iter == op.position.end() || path_iter->second.first != TYPE_STRING)
+        return false;
+    const string &name = op.v_string[op_iter->second.second];
+    const string &path = op.v_string[path_iter->second.second];
+    auto value_iter = op.position.find("value");
+    const entry *value = value_iter == op.position.end() ? nullptr : &value_iter->second;
+    auto from_iter = op.position.find("from");
+    const string *from = nullptr;
+    if (from_iter != op.position.end())
+    {
+        if (from_iter->second.first != TYPE_STRING) return false;
+        from = &op.v_string[from_iter->second.second];
+    }
+
+    // 先只读取地检查路径和目标，全部有效后才unshare经过的节点并使它们的缓存失效
+    const_location target;
+    location loc;
+    if (name == "add" || name == "replace")
+    {
+        if (!value) return false;
+        if (path.empty()) return replace_root(object, array, op, *value, log);
+        if (!walk(object, array, path, target) || !check_target(target, name == "add")) return false;
+        resolve(object, array, path, loc, log);
+        if (name == "add")
+            add(loc, op, *value, log);
+        else
+            replace(loc, op, *value, log);
+        return true;
+    }
+    if (name == "remove")
+    {
+        if (!walk(object, array, path, target) || !check_target(target, false)) return false;
+        resolve(object, array, path, loc, log);
+        remove(loc, log);
+        return true;
+    }
+    if (name == "move" || name == "copy")
+    {
+        value_ref source;
+        if (!from || !lookup(object, array, *from, source)) return false;
+        if (name == "move")
+        {
+            if (*from == path) return true;
+            if (path.compare(0, from->size() + 1, *from + "/") == 0) return false; // 不能移动到自己的子节点中
+        }
+        if (!walk(object, array, path, target) || !check_target(target, true)) return false;
+        // 先拷贝到临时数组中，移动时源节点被删除后再计算目标位置
+        JsonArray holder;
+        holder.position.push_back(source.object ? store(holder, *source.object, source.value)
+                                                : store(holder, *source.array, source.value));
+        if (name == "move")
+        {
+            resolve(object, array, *from, loc, log);
+            remove(loc, log);
+            // 源节点和目标在同一个数组中时删除后下标会变化，再检查一次，失败时由调用者撤销删除
+            if (!walk(object, array, path, target) || !check_target(target, true)) return false;
+        }
+        resolve(object, array, path, loc, log);
+        add(loc, holder, holder.position.front(), log);
+        return true;
+    }
+    if (name == "test")
+    {
+        if (!value) return false;
+        if (path.empty())
+        {
+            return object ? value->first == TYPE_OBJECT && equal(*object, *op.v_object[value->second])
+                          : value->first == TYPE_ARRAY && equal(*array, *op.v_array[value->second]);
+        }
+        value_ref found;
+        if (!lookup(object, array, path, found)) return false;
+        return found.object ? equal(*found.object, found.value, op, *value) : equal(*found.array, found.value, op, *value);
+    }
+    return false; // 不支持的操作
+}
+
+bool Shanhj_Json::JsonPatch::replace_root(JsonObject *object, JsonArray *array, const JsonObject &op, const entry &value,
+                                          journal &log)
+{
+    // 替换整个文档，类型必须相同，保留原来的输出缓存设置，原来的内容移到撤销记录中
+    if (object && value.first == TYPE_OBJECT)
+    {
+        auto old = make_shared<JsonObject>(std::move(*object));
+        *object = *op.v_object[value.second];
+        object->output_cache = old->output_cache;
+        log.undo.push_back([object, old]() { *object = std::move(*old); });
+        return true;
+    }
+    if (array && value.first == TYPE_ARRAY)
+    {
+        auto old = make_shared<JsonArray>(std::move(*array));
+        *array = *op.v_array[value.second];
+        array->output_cache = old->output_cache;
+        log.undo.push_back([array, old]() { *array = std::move(*old); });
+        return true;
+    }
+    return false;
+}
+
+void Shanhj_Json::JsonPatch::merge(JsonObject &target, const JsonObject &patch)
+{
+    compact(target);
+    target.modified();
+    for (auto &item : patch.position)
+    {
+        auto iter = target.position.find(item.first);
+        if (item.second.first == TYPE_NULL)
+        {
+            if (iter != target.position.end()) target.position.erase(iter); // 值留在vector中，之后由compact回收
+        }
+        else if (item.second.first == TYPE_OBJECT) // 对象逐层合并，目标中不是对象时先替换为空对象
+        {
+            if (iter == target.position.end() || iter->second.first != TYPE_OBJECT)
+            {
+                target.v_object.push_back(make_shared<JsonObject>());
+                iter = target.position.insert_or_assign(item.first, entry(TYPE_OBJECT, target.v_object.size() - 1)).first;
+            }
+            merge(unshare(target.v_object[iter->second.second]), *patch.v_object[item.second.second]);
+        }
+        else if (iter != target.position.end())
+            assign(target, iter->second, patch, item.second);
+        else
+            target.position.emplace(item.first, store(target, patch, item.second));
+    }
+}
+
+bool Shanhj_Json::JsonPatch::walk(const JsonObject *object, const JsonArray *array, const string &pointer, const_location &loc)
+{
+    if (pointer.empty() || pointer[0] != '/') return false;
+    size_t begin = 1;
+    string token;
+    while (true)
+    {
+        bool last;
+        if (!read_token(pointer, begin, token, last)) return false;
+        if (last)
+        {
+            loc = {object, array, token};
+            return true;
+        }
+        entry value;
+        if (!find_value(object, array, token, value)) return false;
+        if (value.first == TYPE_OBJECT)
+        {
+            object = (object ? object->v_object[value.second] : array->v_object[value.second]).get();
+            array = nullptr;
+        }
+        else if (value.first == TYPE_ARRAY)
+        {
+            array = (object ? object->v_array[value.second] : array->v_array[value.second]).get();
+            object = nullptr;
+        }
+        else
+            return false;
+    }
+}
+
+bool Shanhj_Json::JsonPatch::check_target(const const_location &loc, bool adding)
+{
+    if (loc.object) return adding || loc.object->position.count(loc.token);
+    if (adding && loc.token == "-") return true;
+    ulong index;
+    return parse_index(loc.token, loc.array->size() + adding, index); // 允许插入到末尾
+}
+
+void Shanhj_Json::JsonPatch::resolve(JsonObject *object, JsonArray *array, const string &pointer, location &loc, journal &log)
+{
+    size_t begin = 1;
+    string token;
+    while (true)
+    {
+        if (object)
+            touch(*object, log);
+        else
+            touch(*array, log);
+        bool last;
+        read_token(pointer, begin, token, last);
+        if (last)
+        {
+            loc = {object, array, token};
+            return;
+        }
+        // 路径已经检查过，中间经过的数组中有子容器，一定是普通形式
+        entry *child = find(object, array, token);
+        if (child->first == TYPE_OBJECT)
+        {
+            object = &unshare_slot(object ? object->v_object : array->v_object, child->second, log);
+            array = nullptr;
+        }
+        else
+        {
+            array = &unshare_slot(object ? object->v_array : array->v_array, child->second, log);
+            object = nullptr;
+        }
+    }
+}
+
+template <typename C>
+void Shanhj_Json::JsonPatch::touch(C &c, journal &log)
+{
+    if (!log.touched.insert(&c).second) return;
+    compact(c);
+    c.modified();
+}
+
+template <typename T>
+T &Shanhj_Json::JsonPatch::unshare_slot(vector<shared_ptr<T>> &nodes, ulong index, journal &log)
+{
+    shared_ptr<T> &node = nodes[index];
+    if (node.use_count() > 1)
+    {
+        // 撤销时换回原来的节点，之后的撤销记录中对原节点的修改才能生效
+        log.undo.push_back([&nodes, index, old = node]() { nodes[index] = old; });
+        node = make_shared<T>(*node);
+    }
+    return *node;
+}
+
+bool Shanhj_Json::JsonPatch::lookup(const JsonObject *object, const JsonArray *array, const string &pointer, value_ref &ref)
+{
+    const_location loc;
+    entry value;
+    if (!walk(object, array, pointer, loc) || !find_value(loc.object, loc.array, loc.token, value)) return false;
+    ref = {loc.object, loc.array, value};
+    return true;
+}
+
+bool Shanhj_Json::JsonPatch::read_token(const string &pointer, size_t &begin, string &token, bool &last)
+{
+    size_t end = pointer.find('/', begin);
+    last = end == string::npos;
+    if (last) end = pointer.size();
+    token.clear();
+    for (size_t i = begin; i < end; i++) // 还原转义的'~'和'/'
+    {
+        if (pointer[i] != '~')
+            token += pointer[i];
+        else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+            token += pointer[++i] == '0' ? '~' : '/';
+        else
+            return false;
+    }
+    begin = end + 1;
+    return true;
+}
+
+Shanhj_Json::JsonPatch::entry *Shanhj_Json::JsonPatch::find(JsonObject *object, JsonArray *array, const string &token)
+{
+    if (object)
+    {
+        auto iter = object->position.find(token);
+        return iter == object->position.end() ? nullptr : &iter->second;
+    }
+    ulong index;
+    if (!parse_index(token, array->position.size(), index)) return nullptr;
+    return &*array_at(*array, index);
+}
+
+bool Shanhj_Json::JsonPatch::find_value(const JsonObject *object, const JsonArray *array, const string &token, entry &value)
+{
+    if (object)
+    {
+        auto iter = object->position.find(token);
+        if (iter == object->position.end()) return false;
+        value = iter->second;
+        return true;
+    }
+    ulong index;
+    if (!parse_index(token, array->size(), index)) return false;
+    value = array->entry_at(index); // 压缩形式的数组直接按下标读取
+    return true;
+}
+
+bool Shanhj_Json::JsonPatch::parse_index(const string &token, ulong limit, ulong &index)
+{
+    if (token.empty() || token.size() > 19 || (token[0] == '0' && token.size() > 1)) return false;
+    index = 0;
+    for (char c : token)
+    {
+        if (c < '0' || c > '9') return false;
+        index = index * 10 + (c - '0');
+    }
+    return index < limit;
+}
+
+std::list<Shanhj_Json::JsonPatch::entry>::iterator Shanhj_Json::JsonPatch::array_at(JsonArray &array, ulong index)
+{
+    // 从距离较近的一端开始遍历链表，index等于元素个数时返回end
+    ulong count = array.position.size();
+    if (index > count / 2)
+    {
+        auto iter = array.position.end();
+        for (ulong i = count; i > index; i--)
+            iter--;
+        return iter;
+    }
+    auto iter = array.position.begin();
+    while (index--)
+        iter++;
+    return iter;
+}
+
+std::string Shanhj_Json::JsonPatch::escape_token(const string &token)
+{
+    string result;
+    for (char c : token)
+    {
+        if (c == '~')
+            result += "~0";
+        else if (c == '/')
+            result += "~1";
+        else
+            result += c;
+    }
+    return result;
+}
+
+template <typename Src>
+void Shanhj_Json::JsonPatch::add(const location &loc, Src &src, const entry &value, journal &log)
+{
+    if (loc.object)
+    {
+        JsonObject *object = loc.object;
+        auto iter = object->position.find(loc.token);
+        if (iter != object->position.end()) // 键已存在时替换原来的值
+        {
+            replace(loc, src, value, log);
+            return;
+        }
+        object->position.emplace(loc.token, store(*object, src, value));
+        log.undo.push_back([object, key = loc.token]() { object->position.erase(key); });
+        return;
+    }
+    JsonArray &array = *loc.array;
+    ulong index = array.size();
+    if (loc.token != "-") parse_index(loc.token, index + 1, index);
+    if (array.packed != TYPE_NULL && put_packed(array, index, true, src, value, log)) return;
+    unpack(array, log);
+    auto iter = array.position.insert(array_at(array, index), store(array, src, value));
+    log.undo.push_back([&array, iter]() { array.position.erase(iter); });
+}
+
+void Shanhj_Json::JsonPatch::remove(const location &loc, journal &log)
+{
+    // 被删除的值留在vector中，撤销时只需要恢复position
+    if (loc.object)
+    {
+        JsonObject *object = loc.object;
+        auto iter = object->position.find(loc.token);
+        log.undo.push_back([object, key = loc.token, old = iter->second]() { object->position.emplace(key, old); });
+        object->position.erase(iter);
+        return;
+    }
+    JsonArray &array = *loc.array;
+    ulong index;
+    parse_index(loc.token, array.size(), index);
+    if (array.packed != TYPE_NULL)
+    {
+        erase_packed(array, index, log);
+        return;
+    }
+    // 链表节点移到log.removed中，撤销时再移回原来的位置
+    auto iter = array_at(array, index);
+    auto next = std::next(iter);
+    log.removed.splice(log.removed.end(), array.position, iter);
+    log.undo.push_back([&array, &removed = log.removed, iter, next]() { array.position.splice(next, removed, iter); });
+}
+
+template <typename Src>
+void Shanhj_Json::JsonPatch::replace(const location &loc, Src &src, const entry &value, journal &log)
+{
+    if (loc.object)
+    {
+        JsonObject *object = loc.object;
+        entry &target = object->position[loc.token];
+        log.undo.push_back([object, key = loc.token, old = target]() { object->position[key] = old; });
+        target = store(*object, src, value);
+        return;
+    }
+    JsonArray &array = *loc.array;
+    ulong index;
+    parse_index(loc.token, array.size(), index);
+    if (array.packed != TYPE_NULL && put_packed(array, index, false, src, value, log)) return;
+    unpack(array, log);
+    auto iter = array_at(array, index);
+    log.undo.push_back([iter, old = *iter]() { *iter = old; });
+    *iter = store(array, src, value);
+}
+
+template <typename Src>
+bool Shanhj_Json::JsonPatch::put_packed(JsonArray &array, ulong index, bool insert, Src &src, const entry &value, journal &log)
+{
+    const int64_t exact = 1LL << 53; // 与JsonArray::append_number相同，只有能精确转换的整数才能放入浮点数组
+    switch (array.packed)
+    {
+    case TYPE_STRING:
+        if (value.first != TYPE_STRING) return false;
+        put_slot(array.v_string, index, insert, string(src.v_string[value.second]), log);
+        return true;
+    case TYPE_INT:
+        if (value.first != TYPE_INT) return false;
+        put_slot(array.v_int, index, insert, src.v_int[value.second], log);
+        return true;
+    case TYPE_BOOLEAN:
+        if (value.first != TYPE_BOOLEAN) return false;
+        put_slot(array.v_boolean, index, insert, (uint8_t)value.second, log);
+        return true;
+    case TYPE_DOUBLE:
+    {
+        bool is_int = value.first == TYPE_INT;
+        if (!is_int && value.first != TYPE_DOUBLE) return false;
+        int64_t int_value = is_int ? src.v_int[value.second] : 0;
+        if (int_value > exact || int_value < -exact) return false;
+        if (is_int && array.int_mark.empty())
+        {
+            array.int_mark.assign(array.v_double.size(), 0);
+            array.v_int.assign(array.v_double.size(), 0);
+            log.undo.push_back([&array]() { array.int_mark.clear(), array.v_int.clear(); });
+        }
+        put_slot(array.v_double, index, insert, is_int ? (double)int_value : src.v_double[value.second], log);
+        if (!array.int_mark.empty())
+        {
+            put_slot(array.int_mark, index, insert, (uint8_t)is_int, log);
+            put_slot(array.v_int, index, insert, int_value, log);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void Shanhj_Json::JsonPatch::erase_packed(JsonArray &array, ulong index, journal &log)
+{
+    switch (array.packed)
+    {
+    case TYPE_STRING:
+        erase_slot(array.v_string, index, log);
+        break;
+    case TYPE_INT:
+        erase_slot(array.v_int, index, log);
+        break;
+    case TYPE_BOOLEAN:
+        erase_slot(array.v_boolean, index, log);
+        break;
+    default:
+        erase_slot(array.v_double, index, log);
+        if (!array.int_mark.empty())
+        {
+            erase_slot(array.int_mark, index, log);
+            erase_slot(array.v_int, index, log);
+        }
+        break;
+    }
+}
+
+template <typename V, typename T>
+void Shanhj_Json::JsonPatch::put_slot(V &values, ulong index, bool insert, T value, journal &log)
+{
+    if (insert)
+    {
+        values.insert(values.begin() + index, std::move(value));
+        log.undo.push_back([&values, index]() { values.erase(values.begin() + index); });
+        return;
+    }
+    log.undo.push_back([&values, index, old = std::move(values[index])]() { values[index] = old; });
+    values[index] = std::move(value);
+}
+
+template <typename V>
+void Shanhj_Json::JsonPatch::erase_slot(V &values, ulong index, journal &log)
+{
+    log.undo.push_back([&values, index, old = std::move(values[index])]() { values.insert(values.begin() + index, old); });
+    values.erase(values.begin() + index);
+}
+
+void Shanhj_Json::JsonPatch::unpack(JsonArray &array, journal &log)
+{
+    if (array.packed == TYPE_NULL) return;
+    // 转换后只会向各个vector末尾追加值，撤销时截断到转换前的长度并恢复压缩形式
+    log.undo.push_back([&array, packed = array.packed, booleans = array.v_boolean, marks = array.int_mark,
+                        strings = array.v_string.size(), ints = array.v_int.size(), doubles = array.v_double.size(),
+                        numbers = array.v_number.size(), text = array.number_text.size(), objects = array.v_object.size(),
+                        arrays = array.v_array.size()]() {
+        array.position.clear();
+        array.packed = packed;
+        array.v_boolean = booleans;
+        array.int_mark = marks;
+        array.v_string.resize(strings);
+        array.v_int.resize(ints);
+        array.v_double.resize(doubles);
+        array.v_number.resize(numbers);
+        array.number_text.resize(text);
+        array.v_object.resize(objects);
+        array.v_array.resize(arrays);
+    });
+    array.unpack();
+}
+
+template <typename Dst, typename Src>
+Shanhj_Json::JsonPatch::entry Shanhj_Json::JsonPatch::store(Dst &dst, Src &src, const entry &value)
+{
+    // 先取出到局部变量再放入，src和dst是同一个容器时vector扩容不会影响到被拷贝的值
+    // 子对象和子数组只拷贝指针，与src共享同一个节点
+    switch (value.first)
+    {
+    case TYPE_STRING:
+    {
+        string tmp = std::move(src.v_string[value.second]);
+        dst.v_string.push_back(std::move(tmp));
+        return {TYPE_STRING, dst.v_string.size() - 1};
+    }
+    case TYPE_INT:
+        dst.v_int.push_back(src.v_int[value.second]);
+        return {TYPE_INT, dst.v_int.size() - 1};
+    case TYPE_DOUBLE:
+        dst.v_double.push_back(src.v_double[value.second]);
+        return {TYPE_DOUBLE, dst.v_double.size() - 1};
+    case TYPE_NUMBER:
+    {
+        raw_number number = src.v_number[value.second];
+        string text = src.number_text.substr(number.offset, number.length); // dst和src可能是同一个容器
+        number.offset = dst.number_text.size();
+        dst.number_text += text;
+        dst.v_number.push_back(number);
+        return {TYPE_NUMBER, dst.v_number.size() - 1};
+    }
+    case TYPE_OBJECT:
+    {
+        shared_ptr<JsonObject> tmp = std::move(src.v_object[value.second]);
+        dst.v_object.push_back(std::move(tmp));
+        return {TYPE_OBJECT, dst.v_object.size() - 1};
+    }
+    case TYPE_ARRAY:
+    {
+        shared_ptr<JsonArray> tmp = std::move(src.v_array[value.second]);
+        dst.v_array.push_back(std::move(tmp));
+        return {TYPE_ARRAY, dst.v_array.size() - 1};
+    }
+    default: // 布尔和null不占用vector
+        return value;
+    }
+}
+
+template <typename Dst, typename Src>
+void Shanhj_Json::JsonPatch::assign(Dst &dst, entry &target, Src &src, const entry &value)
+{
+    if (target.first == value.first)
+    {
+        switch (value.first)
+        {
+        case TYPE_STRING:
+            dst.v_string[target.second] = src.v_string[value.second];
+            return;
+        case TYPE_INT:
+            dst.v_int[target.second] = src.v_int[value.second];
+            return;
+        case TYPE_DOUBLE:
+            dst.v_double[target.second] = src.v_double[value.second];
+            return;
+        case TYPE_OBJECT:
+            dst.v_object[target.second] = src.v_object[value.second];
+            return;
+        case TYPE_ARRAY:
+            dst.v_array[target.second] = src.v_array[value.second];
+            return;
+        default: // 保留原文的数字长度可能不同，和其他类型一样重新放入
+            break;
+        }
+    }
+    target = store(dst, src, value); // 原来的位置不再使用，之后由compact回收
+}
+
+void Shanhj_Json::JsonPatch::compact(JsonObject &object)
+{
+    compact_storage(object);
+}
+
+void Shanhj_Json::JsonPatch::compact(JsonArray &array)
+{
+    if (array.packed == TYPE_NULL) compact_storage(array); // 压缩形式中没有不再使用的值
+}
+
+template <typename C>
+void Shanhj_Json::JsonPatch::compact_storage(C &c)
+{
+    // 不再使用的位置不超过仍在使用的值的个数时不整理，每次整理的开销由之前留下这些位置的修改分摊
+    ulong slots = c.v_string.size() + c.v_int.size() + c.v_double.size() + c.v_number.size() + c.v_object.size() + c.v_array.size();
+    if (slots <= c.position.size() * 2 + 16) return;
+    C fresh;
+    for (auto &item : c.position)
+    {
+        entry &value = entry_of(item);
+        value = store(fresh, c, value);
+    }
+    c.v_string.swap(fresh.v_string);
+    c.v_int.swap(fresh.v_int);
+    c.v_double.swap(fresh.v_double);
+    c.v_number.swap(fresh.v_number);
+    c.number_text.swap(fresh.number_text);
+    c.v_object.swap(fresh.v_object);
+    c.v_array.swap(fresh.v_array);
+}
+
+Shanhj_Json::JsonPatch::entry &Shanhj_Json::JsonPatch::entry_of(pair<const string, entry> &item)
+{
+    return item.second;
+}
+
+Shanhj_Json::JsonPatch::entry &Shanhj_Json::JsonPatch::entry_of(entry &item)
+{
+    return item;
+}
+
+template <typename A, typename B>
+bool Shanhj_Json::JsonPatch::equal(const A &a, const entry &ea, const B &b, const entry &eb)
+{
+    int64_t int_a, int_b;
+    double double_a, double_b;
+    bool is_double_a, is_double_b;
+    if (number_value(a, ea, int_a, double_a, is_double_a) && number_value(b, eb, int_b, double_b, is_double_b))
+    {
+        if (ea.first == TYPE_NUMBER && eb.first == TYPE_NUMBER && a.v_number[ea.second].kind == NUMBER_BIG_INT &&
+            b.v_number[eb.second].kind == NUMBER_BIG_INT) // 转换成浮点数会损失精度，直接比较原文
+        {
+            auto &na = a.v_number[ea.second], &nb = b.v_number[eb.second];
+            return a.number_text.compare(na.offset, na.length, b.number_text, nb.offset, nb.length) == 0;
+        }
+        if (!is_double_a && !is_double_b) return int_a == int_b;
+        return (is_double_a ? double_a : int_a) == (is_double_b ? double_b : int_b);
+    }
+    if (ea.first != eb.first) return false;
+    switch (ea.first)
+    {
+    case TYPE_STRING:
+        return a.v_string[ea.second] == b.v_string[eb.second];
+    case TYPE_BOOLEAN:
+        return ea.second == eb.second;
+    case TYPE_OBJECT:
+        return a.v_object[ea.second] == b.v_object[eb.second] || equal(*a.v_object[ea.second], *b.v_object[eb.second]);
+    case TYPE_ARRAY:
+        return a.v_array[ea.second] == b.v_array[eb.second] || equal(*a.v_array[ea.second], *b.v_array[eb.second]);
+    default:
+        return true;
+    }
+}
+
+template <typename C>
+bool Shanhj_Json::JsonPatch::number_value(const C &c, const entry &value, int64_t &int_value, double &double_value, bool &is_double)
+{
+    switch (value.first)
+    {
+    case TYPE_INT:
+        int_value = c.v_int[value.second];
+        is_double = false;
+        return true;
+    case TYPE_DOUBLE:
+        double_value = c.v_double[value.second];
+        is_double = true;
+        return true;
+    case TYPE_NUMBER:
+        is_double = c.v_number[value.second].kind != NUMBER_INT64;
+        return is_double ? raw_to_double(c.number_text, c.v_number[value.second], double_value)
+                         : raw_to_int(c.number_text, c.v_number[value.second], int_value);
+    default:
+        return false;
+    }
+}
+
+uint64_t Shanhj_Json::JsonPatch::hash(const JsonObject &object)
+{
+    uint64_t sum = 0;
+    for (auto &member : object.position)
+        sum += hash_mix(hash_bytes(member.first.data(), member.first.size(), TYPE_OBJECT) ^ hash(object, member.second));
+    uint64_t value = hash_mix(sum ^ hash_mix(object.position.size() + TYPE_OBJECT));
+    return value ? value : 1; // 0表示没有缓存
+}
+
+uint64_t Shanhj_Json::JsonPatch::hash(const JsonArray &array)
+{
+    // 压缩形式和普通形式的元素序列相同，哈希值也相同
+    uint64_t value = hash_mix(array.size() + TYPE_ARRAY);
+    array.for_each_entry([&](const entry &item) { value = hash_mix(value + hash(array, item)); });
+    return value ? value : 1;
+}
+
+template <typename C>
+uint64_t Shanhj_Json::JsonPatch::hash(const C &c, const entry &value)
+{
+    int64_t int_value;
+    double double_value;
+    bool is_double;
+    if (number_value(c, value, int_value, double_value, is_double))
+    {
+        if (!is_double) double_value = int_value;
+        if (double_value == 0) double_value = 0; // -0.0与0.0相等
+        uint64_t bits;
+        memcpy(&bits, &double_value, sizeof(bits));
+        return hash_mix(bits ^ TYPE_DOUBLE);
+    }
+    switch (value.first)
+    {
+    case TYPE_STRING:
+        return hash_bytes(c.v_string[value.second].data(), c.v_string[value.second].size(), TYPE_STRING);
+    case TYPE_BOOLEAN:
+        return hash_mix(value.second + TYPE_BOOLEAN * 2);
+    case TYPE_OBJECT:
+        return c.v_object[value.second]->hash();
+    case TYPE_ARRAY:
+        return c.v_array[value.second]->hash();
+    default:
+        return hash_mix(TYPE_NULL);
+    }
+}
+
+template <typename T>
+bool Shanhj_Json::JsonPatch::hash_differs(const T &a, const T &b)
+{
+    uint64_t hash_a = a.hash_value.value.load(memory_order_relaxed);
+    uint64_t hash_b = b.hash_value.value.load(memory_order_relaxed);
+    return hash_a && hash_b && hash_a != hash_b;
+}
+
+bool Shanhj_Json::JsonPatch::equal(const JsonObject &a, const JsonObject &b)
+{
+    if (a.position.size() != b.position.size() || hash_differs(a, b)) return false;
+    for (auto ia = a.position.begin(), ib = b.position.begin(); ia != a.position.end(); ia++, ib++)
+    {
+        if (ia->first != ib->first || !equal(a, ia->second, b, ib->second)) return false;
+    }
+    return true;
+}
+
+bool Shanhj_Json::JsonPatch::equal(const JsonArray &a, const JsonArray &b)
+{
+    if (a.size() != b.size() || hash_differs(a, b)) return false;
+    if (a.packed != TYPE_NULL && a.packed == b.packed) // 同类型的压缩数组直接比较存储的值
+    {
+        switch (a.packed)
+        {
+        case TYPE_STRING:
+            return a.v_string == b.v_string;
+        case TYPE_INT:
+            return a.v_int == b.v_int;
+        case TYPE_DOUBLE:
+            return a.v_double == b.v_double;
+        default:
+            return a.v_boolean == b.v_boolean;
+        }
+    }
+    if (a.packed == TYPE_NULL && b.packed == TYPE_NULL)
+    {
+        for (auto ia = a.position.begin(), ib = b.position.begin(); ia != a.position.end(); ia++, ib++)
+        {
+            if (!equal(a, *ia, b, *ib)) return false;
+        }
+        return true;
+    }
+    auto ea = a.entries(), eb = b.entries();
+    for (ulong i = 0; i < ea.size(); i++)
+    {
+        if (!equal(a, ea[i], b, eb[i])) return false;
+    }
+    return true;
+}
+
+void Shanhj_Json::JsonPatch::diff_object(const JsonObject &a, const JsonObject &b, const string &path, JsonArray &patch)
+{
+    for (auto &item : a.position)
+    {
+        string child = path + '/' + escape_token(item.first);
+        auto iter = b.position.find(item.first);
+        if (iter == b.position.end())
+            emit<JsonObject>(patch, "remove", child, nullptr, item.second);
+        else
+            diff_value(a, item.second, b, iter->second, child, patch);
+    }
+    for (auto &item : b.position)
+    {
+        if (!a.position.count(item.first))
+            emit(patch, "add", path + '/' + escape_token(item.first), &b, item.second);
+    }
+}
+
+void Shanhj_Json::JsonPatch::diff_array(const JsonArray &a, const JsonArray &b, const string &path, JsonArray &patch)
+{
+    auto ea = a.entries(), eb = b.entries();
+    // 先比较哈希值，只有哈希值相同时才逐个比较内容
+    vector<uint64_t> ha, hb;
+    ha.reserve(ea.size());
+    hb.reserve(eb.size());
+    for (auto &item : ea)
+        ha.push_back(hash(a, item));
+    for (auto &item : eb)
+        hb.push_back(hash(b, item));
+    auto same = [&](ulong i, ulong j) { return ha[i] == hb[j] && equal(a, ea[i], b, eb[j]); };
+
+    // 去掉相同的开头和结尾，剩下的部分用Myers差分算法计算最长公共子序列
+    ulong head = 0, tail = 0;
+    while (head < ea.size() && head < eb.size() && same(head, head))
+        head++;
+    while (tail < ea.size() - head && tail < eb.size() - head && same(ea.size() - 1 - tail, eb.size() - 1 - tail))
+        tail++;
+    long n = ea.size() - head - tail, m = eb.size() - head - tail;
+    // kept[x]为a中间部分第x个元素对齐到的b中间部分的位置，没有对齐时为-1
+    vector<long> kept(n, -1);
+    if (n && m)
+    {
+        // trace[d]保存编辑次数为d时，每条对角线k=x-y上能到达的最大的x，下标为k+d
+        long offset = n + m;
+        vector<long> furthest(2 * offset + 2, 0);
+        vector<vector<long>> trace;
+        ulong states = 0;
+        bool found = false;
+        for (long d = 0; !found && states <= align_limit; d++)
+        {
+            for (long k = -d; k <= d; k += 2)
+            {
+                // 从相邻的对角线删除a中的一个元素或插入b中的一个元素，再沿对角线跳过相同的元素
+                long x = k == -d || (k != d && furthest[offset + k - 1] < furthest[offset + k + 1]) ? furthest[offset + k + 1]
+                                                                                                  : furthest[offset + k - 1] + 1;
+                long y = x - k;
+                while (x < n && y < m && same(head + x, head + y))
+                    x++, y++;
+                furthest[offset + k] = x;
+                if (x >= n && y >= m)
+                {
+                    found = true;
+                    break;
+                }
+            }
+            trace.emplace_back(furthest.begin() + offset - d, furthest.begin() + offset + d + 1);
+            states += 2 * d + 1;
+        }
+        if (found) // 从终点倒推，记录路径上沿对角线经过的元素
+        {
+            long x = n, y = m;
+            for (long d = trace.size() - 1; d > 0; d--)
+            {
+                const vector<long> &prev = trace[d - 1];
+                long k = x - y;
+                long prev_k = k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]) ? k + 1 : k - 1;
+                long prev_x = prev[prev_k + d - 1], prev_y = prev_x - prev_k;
+                while (x > prev_x && y > prev_y)
+                {
+                    x--, y--;
+                    kept[x] = y;
+                }
+                x = prev_x, y = prev_y;
+            }
+            while (x > 0 && y > 0)
+            {
+                x--, y--;
+                kept[x] = y;
+            }
+        }
+    }
+
+    // 按顺序生成操作，index为当前元素在已执行前面操作的数组中的下标
+    // 两个对齐的元素之间，a和b中未对齐的元素成对时逐个比较，a中多出的删除，b中多出的插入
+    ulong index = head, i = head, j = head;
+    auto flush = [&](ulong a_end, ulong b_end) {
+        for (; i < a_end && j < b_end; i++, j++, index++)
+            diff_value(a, ea[i], b, eb[j], path + '/' + to_string(index), patch);
+        for (; i < a_end; i++)
+            emit<JsonArray>(patch, "remove", path + '/' + to_string(index), nullptr, entry());
+        for (; j < b_end; j++, index++) // 后面没有剩余的元素时追加到末尾
+            emit(patch, "add", i == ea.size() ? path + "/-" : path + '/' + to_string(index), &b, eb[j]);
+    };
+    for (long k = 0; k < n; k++)
+    {
+        if (kept[k] < 0) continue;
+        flush(head + k, head + kept[k]);
+        i++, j++, index++;
+    }
+    flush(ea.size() - tail, eb.size() - tail);
+}
+
+template <typename A, typename B>
+void Shanhj_Json::JsonPatch::diff_value(const A &a, const entry &ea, const B &b, const entry &eb, const string &path, JsonArray &patch)
+{
+    if (ea.first == TYPE_OBJECT && eb.first == TYPE_OBJECT)
+    {
+        if (a.v_object[ea.second] != b.v_object[eb.second]) // 共享的子树一定相同
+            diff_object(*a.v_object[ea.second], *b.v_object[eb.second], path, patch);
+    }
+    else if (ea.first == TYPE_ARRAY && eb.first == TYPE_ARRAY)
+    {
+        if (a.v_array[ea.second] != b.v_array[eb.second])
+            diff_array(*a.v_array[ea.second], *b.v_array[eb.second], path, patch);
+    }
+    else if (ea.first != eb.first || !equal(a, ea, b, eb))
+        emit(patch, "replace", path, &b, eb);
+}
+
+template <typename Src>
+void Shanhj_Json::JsonPatch::emit(JsonArray &patch, const char *op, const string &path, const Src *src, const entry &value)
+{
+    JsonObject item;
+    item.insert("op", op);
+    item.insert("path", path);
+    if (src) item.position["value"] = store(item, *src, value);
+    patch.v_object.push_back(make_shared<JsonObject>(std::move(item)));
+    patch.position.push_back({TYPE_OBJECT, patch.v_object.size() - 1});
+}
+
+template <typename Root>
+std::string Shanhj_Json::ParallelOutput::output(const Root &root, long indent, ulong threads)
+{
+    if (threads == 0) threads = max<ulong>(thread::hardware_concurrency(), 1);
+    planner p;
+    p.cached = root.output_cache;
+    string result;
+    if (threads == 1 || weigh(p, root) < min_split * 2) // 文档较小时拆分和创建线程的开销超过并行的收益
+    {
+        root.output(result, indent, p.cached);
+        return result;
+    }
+    ulong total = p.weights[&root];
+    p.target = max(min_split, total / (threads * 8)); // 任务数为线程数的若干倍，各任务耗时不均时也能分配均匀
+    plan(p, root, indent);
+    run(p, threads);
+    ulong size = 0;
+    for (auto &part : p.parts)
+        size += part.size();
+    result.reserve(size);
+    for (auto &part : p.parts)
+    {
+        result += part;
+        string().swap(part); // 拼接后立即释放，峰值内存约为输出大小的两倍
+    }
+    return result;
+}
+
+std::string &Shanhj_Json::ParallelOutput::planner::text()
+{
+    if (!text_open)
+    {
+        parts.emplace_back();
+        text_open = true;
+    }
+    return parts.back();
+}
+
+void Shanhj_Json::ParallelOutput::planner::add_task(function<void(string &)> task)
+{
+    tasks.push_back({parts.size(), std::move(task)});
+    parts.emplace_back();
+    text_open = false;
+}
+
+Shanhj_Json::ulong Shanhj_Json::ParallelOutput::weigh(planner &p, const JsonObject &object)
+{
+    auto iter = p.weights.find(&object); // 共享的子树只统计一次
+    if (iter != p.weights.end()) return iter->second;
+    ulong weight = 1;
+    for (auto &member : object.position)
+    {
+        if (member.second.first == TYPE_OBJECT)
+            weight += weigh(p, *object.v_object[member.second.second]);
+        else if (member.second.first == TYPE_ARRAY)
+            weight += weigh(p, *object.v_array[member.second.second]);
+        else
+            weight++;
+    }
+    if (weight >= min_split) p.weights[&object] = weight;
+    return weight;
+}
+
+Shanhj_Json::ulong Shanhj_Json::ParallelOutput::weigh(planner &p, const JsonArray &array)
+{
+    auto iter = p.weights.find(&array);
+    if (iter != p.weights.end()) return iter->second;
+    ulong weight = 1;
+    if (array.packed != TYPE_NULL) // 压缩形式的数组中没有子容器
+        weight += array.size();
+    else
+    {
+        for (auto &item : array.position)
+        {
+            if (item.first == TYPE_OBJECT)
+                weight += weigh(p, *array.v_object[item.second]);
+            else if (item.first == TYPE_ARRAY)
+                weight += weigh(p, *array.v_array[item.second]);
+            else
+                weight++;
+        }
+    }
+    if (weight >= min_split) p.weights[&array] = weight;
+    return weight;
+}
+
+Shanhj_Json::ulong Shanhj_Json::ParallelOutput::weight_of(const planner &p, const void *container, ulong count)
+{
+    auto iter = p.weights.find(container);
+    return iter != p.weights.end() ? iter->second : count + 1;
+}
+
+void Shanhj_Json::ParallelOutput::plan(planner &p, const JsonObject &object, long indent)
+{
+    object.output_begin(p.text(), indent);
+    long child_indent = indent >= 0 ? indent + 4 : -1;
+    bool cached = p.cached;
+    auto begin = object.position.begin(); // 当前任务的第一个成员
+    ulong weight = 0;                     // 当前任务中值的个数
+    auto flush = [&](JsonObject::member_iterator end) {
+        if (begin != end)
+        {
+            bool first = begin == object.position.begin();
+            p.add_task([&object, begin, end, first, indent, cached](string &result) {
+                object.output_members(result, begin, end, first, indent, cached);
+            });
+        }
+        begin = end;
+        weight = 0;
+    };
+    for (auto iter = object.position.begin(); iter != object.position.end(); iter++)
+    {
+        auto &value = iter->second;
+        ulong child = 1;
+        if (value.first == TYPE_OBJECT)
+            child = weight_of(p, object.v_object[value.second].get(), object.v_object[value.second]->position.size());
+        else if (value.first == TYPE_ARRAY)
+            child = weight_of(p, object.v_array[value.second].get(), object.v_array[value.second]->size());
+        if (child > p.target) // 子树超过一个任务的大小，拆开后分别输出
+        {
+            flush(iter);
+            JsonObject::output_key(p.text(), iter->first, iter == object.position.begin(), indent);
+            if (value.first == TYPE_OBJECT)
+                plan(p, *object.v_object[value.second], child_indent);
+            else
+                plan(p, *object.v_array[value.second], child_indent);
+            begin = std::next(iter);
+            continue;
+        }
+        weight += child;
+        if (weight >= p.target) flush(std::next(iter));
+    }
+    flush(object.position.end());
+    object.output_end(p.text(), indent);
+}
+
+void Shanhj_Json::ParallelOutput::plan(planner &p, const JsonArray &array, long indent)
+{
+    array.output_begin(p.text(), indent);
+    if (array.packed != TYPE_NULL) // 压缩形式按下标等分
+    {
+        for (ulong begin = 0, count = array.size(); begin < count; begin += p.target)
+        {
+            ulong end = min(begin + p.target, count);
+            p.add_task([&array, begin, end, indent](string &result) { array.output_packed(result, begin, end, begin == 0, indent); });
+        }
+        array.output_end(p.text(), indent);
+        return;
+    }
+    long child_indent = indent >= 0 ? indent + 4 : -1;
+    bool cached = p.cached;
+    auto begin = array.position.begin();
+    ulong weight = 0;
+    auto flush = [&](JsonArray::element_iterator end) {
+        if (begin != end)
+        {
+            bool first = begin == array.position.begin();
+            p.add_task([&array, begin, end, first, indent, cached](string &result) {
+                array.output_elements(result, begin, end, first, indent, cached);
+            });
+        }
+        begin = end;
+        weight = 0;
+    };
+    for (auto iter = array.position.begin(); iter != array.position.end(); iter++)
+    {
+        ulong child = 1;
+        if (iter->first == TYPE_OBJECT)
+            child = weight_of(p, array.v_object[iter->second].get(), array.v_object[iter->second]->position.size());
+        else if (iter->first == TYPE_ARRAY)
+            child = weight_of(p, array.v_array[iter->second].get(), array.v_array[iter->second]->size());
+        if (child > p.target)
+        {
+            flush(iter);
+            JsonArray::output_separator(p.text(), iter == array.position.begin(), indent);
+            if (iter->first == TYPE_OBJECT)
+                plan(p, *array.v_object[iter->second], child_indent);
+            else
+                plan(p, *array.v_array[iter->second], child_indent);
+            begin = std::next(iter);
+            continue;
+        }
+        weight += child;
+        if (weight >= p.target) flush(std::next(iter));
+    }
+    flush(array.position.end());
+    array.output_end(p.text(), indent);
+}
+
+void Shanhj_Json::ParallelOutput::run(planner &p, ulong threads)
+{
+    atomic<ulong> next_task(0);
+    exception_ptr error;
+    mutex error_lock;
+    auto work = [&]() {
+        for (ulong i; (i = next_task.fetch_add(1, memory_order_relaxed)) < p.tasks.size();)
+        {
+            try
+            {
+                p.tasks[i].second(p.parts[p.tasks[i].first]);
+            }
+            catch (...) // 异常不能离开线程，记录后由调用者重新抛出
+            {
+                lock_guard<mutex> lock(error_lock);
+                if (!error) error = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (ulong i = 1; i < threads && i < p.tasks.size(); i++)
+    {
+        try
+        {
+            workers.emplace_back(work);
+        }
+        catch (...) // 无法创建更多线程时由已有的线程完成所有任务
+        {
+            break;
+        }
+    }
+    work();
+    for (auto &worker : workers)
+        worker.join();
+    if (error) rethrow_exception(error);
+}
+
+Shanhj_Json::JsonColumn::JsonColumn(const string &name, value_type type) : name(name), type(type)
+{
+    reset();
+}
+
+bool Shanhj_Json::JsonColumn::valid(ulong row) const
+{
+    return row < rows && (validity[row / 64] >> (row % 64) & 1);
+}
+
+std::string_view Shanhj_Json::JsonColumn::get_string(ulong row) const
+{
+    if (type != TYPE_STRING || row >= rows) return string_view();
+    return string_view(chars.data() + offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+void Shanhj_Json::JsonColumn::reset()
+{
+    rows = 0;
+    validity.clear();
+    ints.clear();
+    doubles.clear();
+    booleans.clear();
+    chars.clear();
+    offsets.assign(1, 0);
+}
+
+void Shanhj_Json::JsonColumn::add_row()
+{
+    if (rows % 64 == 0) validity.push_back(0);
+    rows++;
+    switch (type)
+    {
+    case TYPE_INT:
+        ints.push_back(0);
+        break;
+    case TYPE_DOUBLE:
+        doubles.push_back(0);
+        break;
+    case TYPE_BOOLEAN:
+        booleans.push_back(0);
+        break;
+    case TYPE_STRING:
+        offsets.push_back(chars.size());
+        break;
+    default:
+        break;
+    }
+}
+
+void Shanhj_Json::JsonColumn::mark(bool is_valid)
+{
+    ulong row = rows - 1;
+    if (is_valid)
+    {
+        validity[row / 64] |= (uint64_t)1 << (row % 64);
+        return;
+    }
+    validity[row / 64] &= ~((uint64_t)1 << (row % 64));
+    switch (type) // 同一个键出现多次时，之前存入的值也要清除
+    {
+    case TYPE_INT:
+        ints.back() = 0;
+        break;
+    case TYPE_DOUBLE:
+        doubles.back() = 0;
+        break;
+    case TYPE_BOOLEAN:
+        booleans.back() = 0;
+        break;
+    case TYPE_STRING:
+        chars.resize(offsets[row]);
+        offsets.back() = chars.size();
+        break;
+    default:
+        break;
+    }
+}
+
+Shanhj_Json::JsonArrayReader::JsonArrayReader(const string &path, ulong chunk_size, const parse_limits &limits,
+                                              stream_format format, ulong ring_size)
+    : chunk_size(chunk_size ? chunk_size : 1), parser(limits), format(format)
+{
+    if (format != STREAM_ARRAY) state = STATE_FIRST; // 没有外层的'['
+    file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        fail(window.data(), ERROR_IO, "");
+        return;
+    }
+#ifdef SHANHJ_JSON_ZLIB
+    // 以gzip头（0x1f 0x8b）开始的文件边读边解压，否则读入的两个字节作为第一块的开头
+    input.resize(2);
+    input.resize(fread(&input[0], 1, 2, file));
+    if (input.size() == 2 && (uint8_t)input[0] == 0x1f && (uint8_t)input[1] == 0x8b)
+    {
+        memset(&inflater, 0, sizeof(inflater));
+        if (inflateInit2(&inflater, 15 + 16) != Z_OK) // 15为最大的窗口，加16表示只接受gzip格式
+        {
+            fail(window.data(), ERROR_IO, "");
+            return;
+        }
+        gzip = true;
+        inflater.next_in = (Bytef *)&input[0];
+        inflater.avail_in = 2;
+    }
+#endif
+    ring.resize(ring_size ? ring_size : 1);
+    for (auto &chunk : ring)
+        chunk.resize(this->chunk_size);
+    ring_sizes.resize(ring.size());
+    reader = thread(&JsonArrayReader::read_ahead, this);
+}
+
+Shanhj_Json::JsonArrayReader::~JsonArrayReader()
+{
+    if (reader.joinable())
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stop = true;
+        }
+        changed.notify_all();
+        reader.join();
+    }
+#ifdef SHANHJ_JSON_ZLIB
+    if (gzip) inflateEnd(&inflater);
+#endif
+    if (file) fclose(file);
+}
+
+bool Shanhj_Json::JsonArrayReader::next(JsonObject &element)
+{
+    return next_element(element);
+}
+
+bool Shanhj_Json::JsonArrayReader::next(JsonArray &element)
+{
+    return next_element(element);
+}
+
+bool Shanhj_Json::JsonArrayReader::failed() const
+{
+    return state == STATE_FAILED;
+}
+
+const Shanhj_Json::parse_error &Shanhj_Json::JsonArrayReader::last_error() const
+{
+    return error;
+}
+
+template <typename T>
+bool Shanhj_Json::JsonArrayReader::next_element(T &element)
+{
+    static const char *const expected[] = {"'['", "value or ']'", "value", "',' or ']'"};
+    bool result;
+    bool parsed = false; // 单个文档已经解析完，正在检查之后的内容
+    while (state != STATE_END && state != STATE_FAILED)
+    {
+        char *begin = &window[0] + consumed, *end = &window[0] + window.size();
+        if (format == STREAM_NDJSON && state == STATE_NEXT) // 值之后到行末只能有空白字符
+        {
+            while (begin != end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+                begin++;
+            consumed = begin - window.data();
+            if (begin == end)
+            {
+                if (!next_chunk("newline")) return false;
+                continue;
+            }
+            if (*begin != '\n') return fail(begin, ERROR_UNEXPECTED_TOKEN, "newline");
+            consumed++;
+            state = STATE_ELEMENT;
+            continue;
+        }
+        if (!skip_space(begin, end))
+        {
+            consumed = window.size();
+            if (!next_chunk(format == STREAM_ARRAY ? expected[state] : state == STATE_NEXT ? "end of input" : "value"))
+                return parsed && state == STATE_END;
+            continue;
+        }
+        consumed = begin - window.data();
+        if (format == STREAM_DOCUMENT && state == STATE_NEXT)
+            return fail(begin, ERROR_UNEXPECTED_TOKEN, "end of input");
+        if (state == STATE_BEGIN)
+        {
+            if (*begin != '[') return fail(begin, ERROR_UNEXPECTED_TOKEN, expected[state]);
+            consumed++;
+            state = STATE_FIRST;
+            continue;
+        }
+        if (format == STREAM_ARRAY && (state == STATE_NEXT || (state == STATE_FIRST && *begin == ']')))
+        {
+            if (*begin == ']')
+            {
+                consumed++;
+                state = STATE_END;
+                break;
+            }
+            if (*begin != ',') return fail(begin, ERROR_UNEXPECTED_TOKEN, expected[state]);
+            consumed++;
+            state = STATE_ELEMENT;
+            continue;
+        }
+
+        // 窗口中可能包含后面的多个元素，max_document_size只限制当前元素
+        ulong available = end - begin;
+        char *element_end = available > parser.limits.max_document_size ? begin + parser.limits.max_document_size : end;
+        char *stop_pos = parser.parse(begin, element_end, element, result);
+        if (result)
+        {
+            consumed = stop_pos - window.data();
+            state = STATE_NEXT;
+            if (format != STREAM_DOCUMENT) return true;
+            parsed = true; // 单个文档继续检查之后是否只有空白字符
+            continue;
+        }
+        const parse_error &parser_error = parser.last_error();
+        if (parser_error.code != ERROR_TRUNCATED)
+            return fail(stop_pos, parser_error.code, parser_error.expected);
+        if (element_end != end)
+            return fail(element_end, ERROR_LIMIT_EXCEEDED, "");
+        // 元素还没有完整读入，读入的内容至少翻倍后再重新解析，大元素的重复解析总量保持线性
+        while (window.size() - consumed < 2 * available)
+        {
+            if (!fill())
+            {
+                if (window.size() - consumed > available) break;
+                return fail(window.data() + window.size(), io_error ? ERROR_IO : ERROR_TRUNCATED, parser_error.expected);
+            }
+        }
+    }
+    return false;
+}
+
+bool Shanhj_Json::JsonArrayReader::fill()
+{
+    if (drained) return false;
+    if (consumed)
+    {
+        ulong line, col;
+        locate_position(window.data(), window.data() + consumed, line, col);
+        lines += line - 1;
+        column = line == 1 ? column + col - 1 : col - 1;
+        window.erase(0, consumed);
+        window_offset += consumed;
+        consumed = 0;
+    }
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return ring_count > 0; });
+    // 读好的块在被取走之前不会被后台线程修改，拷贝时不需要加锁
+    ulong size = ring_sizes[ring_head];
+    guard.unlock();
+    window.append(ring[ring_head].data(), size);
+    guard.lock();
+    ring_head = (ring_head + 1) % ring.size();
+    ring_count--;
+    drained = file_end && ring_count == 0;
+    guard.unlock();
+    changed.notify_all();
+    return size > 0;
+}
+
+bool Shanhj_Json::JsonArrayReader::next_chunk(const char *expected)
+{
+    if (fill()) return true;
+    // NDJSON可以在任意两行之间结束，单个文档在解析完之后结束
+    if (!io_error && (format == STREAM_NDJSON || (format == STREAM_DOCUMENT && state == STATE_NEXT)))
+    {
+        state = STATE_END;
+        return false;
+    }
+    return fail(window.data() + window.size(), io_error ? ERROR_IO : ERROR_TRUNCATED, expected);
+}
+
+void Shanhj_Json::JsonArrayReader::read_ahead()
+{
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        changed.wait(guard, [this] { return stop || ring_count < ring.size(); });
+        if (stop) return;
+        ulong slot = (ring_head + ring_count) % ring.size();
+        guard.unlock();
+        bool end = false, bad = false;
+        ulong size = read_chunk(&ring[slot][0], end, bad);
+        guard.lock();
+        ring_sizes[slot] = size;
+        ring_count++;
+        file_end = end;
+        io_error = bad;
+        changed.notify_all();
+        if (end) return;
+    }
+}
+
+Shanhj_Json::ulong Shanhj_Json::JsonArrayReader::read_chunk(char *out, bool &end, bool &bad)
+{
+#ifdef SHANHJ_JSON_ZLIB
+    if (gzip) return inflate_chunk(out, end, bad);
+#endif
+    ulong size = min(input.size() - input_pos, chunk_size); // 判断格式时已经读入的开头
+    memcpy(out, input.data() + input_pos, size);
+    input_pos += size;
+    size += fread(out + size, 1, chunk_size - size, file);
+    end = size < chunk_size;
+    bad = end && ferror(file);
+    return size;
+}
+
+#ifdef SHANHJ_JSON_ZLIB
+Shanhj_Json::ulong Shanhj_Json::JsonArrayReader::inflate_chunk(char *out, bool &end, bool &bad)
+{
+    ulong produced = 0;
+    while (produced < chunk_size)
+    {
+        if (inflater.avail_in == 0)
+        {
+            if (input_end) // 压缩数据已经用完，最后一个gzip成员没有结束说明文件被截断
+            {
+                end = true;
+                bad = member_open;
+                break;
+            }
+            input.resize(compressed_chunk);
+            ulong size = fread(&input[0], 1, input.size(), file);
+            if (size < input.size())
+            {
+                input_end = true;
+                if (ferror(file))
+                {
+                    end = bad = true;
+                    break;
+                }
+            }
+            inflater.next_in = (Bytef *)&input[0];
+            inflater.avail_in = size;
+            continue;
+        }
+        inflater.next_out = (Bytef *)out + produced;
+        inflater.avail_out = min<ulong>(chunk_size - produced, UINT_MAX);
+        member_open = true;
+        int code = inflate(&inflater, Z_NO_FLUSH);
+        produced = (char *)inflater.next_out - out;
+        if (code == Z_STREAM_END) // 一个gzip成员结束，之后可能还有首尾相连的下一个成员
+        {
+            member_open = false;
+            inflateReset(&inflater);
+        }
+        else if (code != Z_OK && code != Z_BUF_ERROR)
+        {
+            end = bad = true;
+            break;
+        }
+    }
+    return produced;
+}
+#endif
+
+bool Shanhj_Json::JsonArrayReader::fail(const char *position, error_code code, const char *expected)
+{
+    ulong line, col;
+    locate_position(window.data(), position, line, col);
+    error.code = code;
+    error.expected = expected;
+    error.offset = window_offset + (position - window.data());
+    error.line = lines + line;
+    error.column = line == 1 ? column + col : col;
+    state = STATE_FAILED;
+    return false;
+}
+
+bool Shanhj_Json::JsonSchema::compile(const JsonObject &schema)
+{
+    nodes.clear();
+    if (compile_node(schema) >= 0) return true;
+    nodes.clear();
+    return false;
+}
+
+long Shanhj_Json::JsonSchema::compile_node(const JsonObject &schema)
+{
+    long index = nodes.size();
+    nodes.emplace_back(); // 编译子schema时nodes会增长，因此每次都通过下标访问当前节点
+    for (auto &member : schema.position)
+    {
+        const string &keyword = member.first;
+        auto &value = member.second;
+        if (keyword == "type")
+        {
+            unsigned types = 0;
+            if (value.first == TYPE_STRING)
+            {
+                if (!read_type(schema.v_string[value.second], types)) return -1;
+            }
+            else if (value.first == TYPE_ARRAY)
+            {
+                auto &names = *schema.v_array[value.second];
+                for (auto &name : names.entries())
+                {
+                    if (name.first != TYPE_STRING || !read_type(names.v_string[name.second], types)) return -1;
+                }
+            }
+            else
+                return -1;
+            nodes[index].types = types;
+        }
+        else if (keyword == "properties")
+        {
+            if (value.first != TYPE_OBJECT) return -1;
+            auto &properties = *schema.v_object[value.second];
+            for (auto &property : properties.position)
+            {
+                if (property.second.first != TYPE_OBJECT) return -1;
+                long child = compile_node(*properties.v_object[property.second.second]);
+                if (child < 0) return -1;
+                nodes[index].fields[property.first].schema = child;
+            }
+        }
+        else if (keyword == "required")
+        {
+            if (value.first != TYPE_ARRAY) return -1;
+            auto &names = *schema.v_array[value.second];
+            for (auto &name : names.entries())
+            {
+                if (name.first != TYPE_STRING) return -1;
+                field &required = nodes[index].fields[names.v_string[name.second]];
+                if (required.required >= 0) continue; // 重复的键
+                if (nodes[index].required_count == 64) return -1;
+                required.required = nodes[index].required_count++;
+            }
+        }
+        else if (keyword == "items")
+        {
+            if (value.first != TYPE_OBJECT) return -1;
+            long child = compile_node(*schema.v_object[value.second]);
+            if (child < 0) return -1;
+            nodes[index].items = child;
+        }
+        else if (keyword == "enum")
+        {
+            if (value.first != TYPE_ARRAY) return -1;
+            auto &values = *schema.v_array[value.second];
+            nodes[index].has_enum = true;
+            for (auto &item : values.entries())
+            {
+                double number;
+                if (item.first == TYPE_STRING)
+                    nodes[index].enum_strings.push_back(values.v_string[item.second]);
+                else if (item.first == TYPE_BOOLEAN)
+                    nodes[index].enum_literals |= item.second ? 2 : 1;
+                else if (item.first == TYPE_NULL)
+                    nodes[index].enum_literals |= 4;
+                else if (read_number(values, item, number))
+                    nodes[index].enum_numbers.push_back(number);
+                else // 不支持对象和数组
+                    return -1;
+            }
+        }
+        else if (keyword == "minimum")
+        {
+            if (!read_number(schema, value, nodes[index].minimum)) return -1;
+        }
+        else if (keyword == "maximum")
+        {
+            if (!read_number(schema, value, nodes[index].maximum)) return -1;
+        }
+        else if (keyword == "minLength")
+        {
+            if (!read_count(schema, value, nodes[index].min_length)) return -1;
+        }
+        else if (keyword == "maxLength")
+        {
+            if (!read_count(schema, value, nodes[index].max_length)) return -1;
+        }
+        else if (keyword == "minItems")
+        {
+            if (!read_count(schema, value, nodes[index].min_items)) return -1;
+        }
+        else if (keyword == "maxItems")
+        {
+            if (!read_count(schema, value, nodes[index].max_items)) return -1;
+        }
+        else if (keyword != "$schema" && keyword != "$id" && keyword != "$comment" && keyword != "title" &&
+                 keyword != "description" && keyword != "default" && keyword != "examples") // 不影响校验的注释类关键字
+            return -1;
     }
+    return index;
 }
 
-void Shanhj_Json::JsonObject::insert(const string &key, double value)
+template <typename C>
+bool Shanhj_Json::JsonSchema::read_number(const C &c, const pair<value_type, ulong> &value, double &result)
 {
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_DOUBLE)
+    int64_t int_value = 0;
+    switch (value.first)
     {
-        v_double[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_DOUBLE, v_double.size()};
-        v_double.push_back(value);
+    case TYPE_INT:
+        result = c.v_int[value.second];
+        return true;
+    case TYPE_DOUBLE:
+        result = c.v_double[value.second];
+        return true;
+    case TYPE_NUMBER:
+        if (raw_to_double(c.number_text, c.v_number[value.second], result)) return true;
+        raw_to_int(c.number_text, c.v_number[value.second], int_value);
+        result = int_value;
+        return true;
+    default:
+        return false;
     }
 }
 
-void Shanhj_Json::JsonObject::insert(const string &key, const JsonObject &value)
+bool Shanhj_Json::JsonSchema::read_count(const JsonObject &schema, const pair<value_type, ulong> &value, ulong &result)
 {
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_OBJECT)
-    {
-        v_object[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_OBJECT, v_object.size()};
-        v_object.push_back(value);
-    }
+    int64_t int_value;
+    if (value.first == TYPE_INT)
+        int_value = schema.v_int[value.second];
+    else if (value.first != TYPE_NUMBER || !raw_to_int(schema.number_text, schema.v_number[value.second], int_value))
+        return false;
+    if (int_value < 0) return false;
+    result = int_value;
+    return true;
 }
 
-void Shanhj_Json::JsonObject::insert(const string &key, const JsonArray &value)
+bool Shanhj_Json::JsonSchema::read_type(const string &name, unsigned &types)
 {
-    // 已经存在相同键值的变量，并且是同一类型的
-    if (position.count(key) && position[key].first == TYPE_ARRAY)
-    {
-        v_array[position[key].second] = value;
-    }
-    else
-    { // 不存在相同键值的变量，或者存在相同键值但类型不同的变量，插入新的值
-        // 旧的键值对仍然留在vector里，但不再使用
-        position[key] = {TYPE_ARRAY, v_array.size()};
-        v_array.push_back(value);
-    }
+    if (name == "string") types |= BIT_STRING;
+    else if (name == "integer") types |= BIT_INTEGER;
+    else if (name == "number") types |= BIT_NUMBER | BIT_INTEGER;
+    else if (name == "boolean") types |= BIT_BOOLEAN;
+    else if (name == "object") types |= BIT_OBJECT;
+    else if (name == "array") types |= BIT_ARRAY;
+    else if (name == "null") types |= BIT_NULL;
+    else return false;
+    return true;
 }
 
-bool Shanhj_Json::JsonObject::get_string(const string &key, string &result)
+const char *Shanhj_Json::JsonSchema::check_string(long rule, const string &value) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_STRING) return false; // 不存在该类型的键值对
-    result = v_string[pos.second];
-    return true;
+    const node &n = nodes[rule];
+    if (!(n.types & BIT_STRING)) return "type";
+    if (n.has_enum)
+    {
+        bool found = false;
+        for (auto &candidate : n.enum_strings)
+            found = found || candidate == value;
+        if (!found) return "enum";
+    }
+    if (n.min_length || n.max_length != ULONG_MAX)
+    {
+        ulong length = 0;
+        for (char c : value) // utf-8的后续字节形如10xxxxxx，不计入长度
+            length += (c & 0xC0) != 0x80;
+        if (length < n.min_length) return "minLength";
+        if (length > n.max_length) return "maxLength";
+    }
+    return nullptr;
 }
 
-bool Shanhj_Json::JsonObject::get_boolean(const string &key, bool &result)
+const char *Shanhj_Json::JsonSchema::check_number(long rule, const char *begin, const char *end) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_BOOLEAN) return false; // 不存在该类型的键值对
-    result = pos.second;
-    return true;
+    const node &n = nodes[rule];
+    bool integral = true; // 没有小数部分和指数部分
+    for (const char *c = begin; c < end; c++)
+        integral = integral && *c != '.' && *c != 'e' && *c != 'E';
+    bool accepted = n.types & (integral ? BIT_INTEGER : BIT_NUMBER);
+    // 只允许integer时，1.0、1e2这样值为整数的写法也可以接受，需要转换后再判断
+    bool by_value = !accepted && (n.types & BIT_INTEGER);
+    if (!accepted && !by_value) return "type";
+    if (!by_value && !n.has_enum && n.minimum == -HUGE_VAL && n.maximum == HUGE_VAL) return nullptr;
+    double value = strtod(string(begin, end).c_str(), nullptr);
+    if (by_value && !(std::isfinite(value) && value == std::floor(value))) return "type";
+    if (n.has_enum)
+    {
+        bool found = false;
+        for (double candidate : n.enum_numbers)
+            found = found || candidate == value;
+        if (!found) return "enum";
+    }
+    if (value < n.minimum) return "minimum";
+    if (value > n.maximum) return "maximum";
+    return nullptr;
 }
 
-bool Shanhj_Json::JsonObject::get_int(const string &key, int64_t &result)
+const char *Shanhj_Json::JsonSchema::check_literal(long rule, value_type type, bool value) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_INT) return false; // 不存在该类型的键值对
-    result = v_int[pos.second];
-    return true;
+    const node &n = nodes[rule];
+    if (!(n.types & (type == TYPE_NULL ? BIT_NULL : BIT_BOOLEAN))) return "type";
+    if (n.has_enum && !(n.enum_literals & (type == TYPE_NULL ? 4 : value ? 2 : 1))) return "enum";
+    return nullptr;
 }
 
-bool Shanhj_Json::JsonObject::get_double(const string &key, double &result)
+const char *Shanhj_Json::JsonSchema::check_container(long rule, value_type type) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_DOUBLE) return false; // 不存在该类型的键值对
-    result = v_double[pos.second];
-    return true;
+    const node &n = nodes[rule];
+    if (!(n.types & (type == TYPE_OBJECT ? BIT_OBJECT : BIT_ARRAY))) return "type";
+    if (n.has_enum) return "enum"; // enum中只能有基本类型
+    return nullptr;
 }
 
-bool Shanhj_Json::JsonObject::get_object(const string &key, JsonObject &result)
+const char *Shanhj_Json::JsonSchema::check_end(long rule, bool is_object, ulong count, uint64_t seen) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_OBJECT) return false; // 不存在该类型的键值对
-    result = v_object[pos.second];
-    return true;
+    const node &n = nodes[rule];
+    if (!is_object) return count < n.min_items ? "minItems" : nullptr;
+    uint64_t all = n.required_count == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n.required_count) - 1;
+    return seen == all ? nullptr : "required";
 }
 
-bool Shanhj_Json::JsonObject::get_array(const string &key, JsonArray &result)
+long Shanhj_Json::JsonSchema::property(long rule, const string &key, uint64_t &seen) const
 {
-    if (!position.count(key)) return false; // 不存在该键值
-    auto pos = position[key];
-    if (pos.first != TYPE_ARRAY) return false; // 不存在该类型的键值对
-    result = v_array[pos.second];
-    return true;
+    auto &fields = nodes[rule].fields;
+    if (fields.empty()) return -1;
+    auto iter = fields.find(key);
+    if (iter == fields.end()) return -1;
+    if (iter->second.required >= 0) seen |= (uint64_t)1 << iter->second.required;
+    return iter->second.schema;
 }
 
-void Shanhj_Json::JsonObject::clear()
+Shanhj_Json::JsonProjection::JsonProjection() : nodes(1)
 {
-    position.clear();
-    v_array.clear();
-    v_double.clear();
-    v_int.clear();
-    v_object.clear();
-    v_string.clear();
 }
 
-std::string Shanhj_Json::JsonObject::output_to_string(long indent)
+bool Shanhj_Json::JsonProjection::add(const string &path)
 {
-    string result;
-    result += "{";
-    if (position.size())
+    if (path.empty())
     {
-        if (indent >= 0) result += '\n';
-        bool flag = 0;
-        for (auto entry : position)
+        whole = true;
+        return true;
+    }
+    if (path[0] != '/') return false;
+    long current = 0;
+    size_t begin = 1;
+    while (true)
+    {
+        size_t end = path.find('/', begin);
+        string token;
+        for (size_t i = begin; i < end && i < path.size(); i++) // 还原转义的'~'和'/'
         {
-            if (!flag)
-                flag = 1;
+            if (path[i] != '~')
+                token += path[i];
+            else if (i + 1 < path.size() && (path[i + 1] == '0' || path[i + 1] == '1'))
+                token += path[++i] == '0' ? '~' : '/';
             else
-            {
-                result += ',';
-                if (indent >= 0) result += '\n';
-            }
-            if (indent >= 0)
-            {
-                for (int i = 0; i < indent + 4; i++) // 缩进
-                    result += ' ';
-            }
-            result += '\"';
-            result += binary_to_text(entry.first);
-            result += "\":";
-            if (indent >= 0) result += ' ';
-            switch (entry.second.first)
-            {
-            case TYPE_STRING:
-                result += '\"';
-                result += binary_to_text(v_string[entry.second.second]);
-                result += '\"';
-                break;
-            case TYPE_BOOLEAN:
-                result += entry.second.second ? "true" : "false";
-                break;
-            case TYPE_INT:
-                result += to_string(v_int[entry.second.second]);
-                break;
-            case TYPE_DOUBLE:
-                result += to_string(v_double[entry.second.second]);
-                break;
-            case TYPE_OBJECT:
-                result += v_object[entry.second.second].output_to_string(indent >= 0 ? indent + 4 : -1);
-                break;
-            case TYPE_ARRAY:
-                result += v_array[entry.second.second].output_to_string(indent >= 0 ? indent + 4 : -1);
-                break;
-            case TYPE_NULL:
-                result += "null";
-                break;
-            default:
-                break;
-            }
+                return false;
         }
-        if (indent >= 0)
+        auto iter = nodes[current].fields.find(token);
+        if (iter != nodes[current].fields.end() && iter->second < 0) return true; // 已经保留了整个值
+        if (end == string::npos) // 最后一级，保留整个值，原来更深的路径不再需要
         {
-            result += '\n';
-            for (int i = 0; i < indent; i++)
-                result += ' ';
+            nodes[current].fields[token] = -1;
+            return true;
         }
+        if (iter != nodes[current].fields.end())
+            current = iter->second;
+        else
+        {
+            long child = nodes.size();
+            nodes[current].fields.emplace(token, child);
+            nodes.emplace_back();
+            current = child;
+        }
+        begin = end + 1;
     }
-    result += "}";
-    return result;
 }
 
-char *Shanhj_Json::JsonObject::parser_from_array(char *array_begin, char *array_end, bool &result)
+bool Shanhj_Json::JsonProjection::select(long mask, const string &key, long &child) const
 {
-    parser_array_check(array_begin, array_end);
-    ulong value_order = 0;
-    clear();
-    if (!skip_space(array_begin, array_end))
-    {
-        result = false;
-        return array_begin;
-    }
-    if (*array_begin != '{')
-    {
-        result = false;
-        return array_begin;
-    }
-    array_begin++;
-    parser_array_check(array_begin, array_end);
-    while (array_begin < array_end)
+    auto &fields = nodes[mask].fields;
+    auto iter = fields.find(key);
+    if (iter == fields.end()) return false;
+    child = iter->second;
+    return true;
+}
+
+constexpr Shanhj_Json::StaticParser::StaticParser(const char *text, static_node *nodes, char *chars)
+    : text(text), nodes(nodes), chars(chars)
+{
+}
+
+constexpr Shanhj_Json::ulong Shanhj_Json::StaticParser::run()
+{
+    skip_space();
+    check(text[pos] == '{' || text[pos] == '[', "json literal must be an object or an array");
+    parse_value();
+    skip_space();
+    check(text[pos] == 0, "unexpected content after json literal");
+    return count;
+}
+
+constexpr void Shanhj_Json::StaticParser::check(bool ok, const char *message) const
+{
+    if (!ok) throw invalid_argument(message); // 在常量表达式中执行到throw即为编译错误
+}
+
+constexpr void Shanhj_Json::StaticParser::skip_space()
+{
+    while (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\t' || text[pos] == '\r')
+        pos++;
+}
+
+constexpr void Shanhj_Json::StaticParser::parse_value()
+{
+    ulong index = count++;
+    char c = text[pos];
+    if (c == '{' || c == '[')
     {
-        if (!skip_space(array_begin, array_end))
-        {
-            result = false;
-            return array_begin;
-        }
-        if (*array_begin != '\"')
-        {
-            if (*array_begin == '}' && value_order == 0) break;
-            result = false;
-            return array_begin;
-        }
-        array_begin++;
-        parser_array_check(array_begin, array_end);
-        string key; // 获取键值
-        if (!get_binary_from_text(array_begin, array_end, key))
-        {
-            result = false;
-            return array_begin;
-        }
-        if (!skip_space(array_begin, array_end))
-        {
-            result = false;
-            return array_begin;
-        }
-        if (*array_begin != ':')
-        {
-            result = false;
-            return array_begin;
-        }
-        array_begin++;
-        parser_array_check(array_begin, array_end);
-        if (!skip_space(array_begin, array_end))
-        {
-            result = false;
-            return array_begin;
-        }
-        // 获取值
-        if (*array_begin == '\"') // 字符串类型
-        {
-            array_begin++;
-            parser_array_check(array_begin, array_end);
-            string str;
-            if (!get_binary_from_text(array_begin, array_end, str))
-            {
-                result = false;
-                return array_begin;
-            }
-            insert(key, str);
-        }
-        else if (*array_begin == 't') // 布尔类型，true
-        {
-            char tmp[5];
-            memcpy(tmp, array_begin, 4);
-            tmp[4] = 0;
-            if (strcmp(tmp, "true") == 0)
-                insert(key, true);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 4;
-            parser_array_check(array_begin, array_end);
-        }
-        else if (*array_begin == 'f') // 布尔类型，false
-        {
-            char tmp[6];
-            memcpy(tmp, array_begin, 5);
-            tmp[5] = 0;
-            if (strcmp(tmp, "false") == 0)
-                insert(key, false);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 5;
-            parser_array_check(array_begin, array_end);
-        }
-        else if ((*array_begin >= '0' && *array_begin <= '9') || *array_begin == '-') // 数字类型
+        bool is_object = c == '{';
+        char close = is_object ? '}' : ']';
+        ulong size = 0;
+        pos++;
+        skip_space();
+        if (text[pos] == close)
+            pos++;
+        else
         {
-            string num;
-            if (*array_begin == '-')
+            while (true)
             {
-                num += '-';
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-            }
-            if (*array_begin == '0') // 0开头
-            {
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-                if (*array_begin != '.' && (*array_begin < '0' || *array_begin > '9'))
-                    insert(key, 0);
-                else if (*array_begin == '.')
+                ulong key_offset = 0, key_length = 0;
+                if (is_object) // 获取键值
                 {
-                    num = "0.";
-                    array_begin++;
-                    parser_array_check(array_begin, array_end);
-                    bool flag = 0;
-                    while (*array_begin >= '0' && *array_begin <= '9')
-                    {
-                        flag = 1;
-                        num += *array_begin;
-                        array_begin++;
-                        parser_array_check(array_begin, array_end);
-                    }
-                    if (!flag)
-                    {
-                        result = false;
-                        return array_begin;
-                    }
-                    insert(key, stod(num));
+                    check(text[pos] == '\"', "expected '\"'");
+                    pos++;
+                    parse_string(key_offset, key_length);
+                    skip_space();
+                    check(text[pos] == ':', "expected ':'");
+                    pos++;
+                    skip_space();
                 }
-            }
-            else if (*array_begin >= '1' && *array_begin <= '9') // 1-9开头
-            {
-                ulong dot_cnt = 0; // 统计小数点个数
-                num += *array_begin;
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-                while ((*array_begin >= '0' && *array_begin <= '9') || *array_begin == '.')
+                ulong child = count;
+                parse_value();
+                if (nodes && is_object)
                 {
-                    if (*array_begin == '.') dot_cnt++;
-                    num += *array_begin;
-                    array_begin++;
-                    parser_array_check(array_begin, array_end);
+                    nodes[child].key_offset = key_offset;
+                    nodes[child].key_length = key_length;
                 }
-                if (dot_cnt > 1 || num.back() == '.')
+                size++;
+                skip_space();
+                if (text[pos] == ',')
                 {
-                    result = false;
-                    return array_begin;
+                    pos++;
+                    skip_space();
+                    continue;
                 }
-                if (dot_cnt == 1) // 有小数点，为浮点数
-                    insert(key, stod(num));
-                else
-                    insert(key, stoll(num));
-            }
-            else // 非数字开头，错误
-            {
-                result = false;
-                return array_begin;
+                check(text[pos] == close, is_object ? "expected ',' or '}'" : "expected ',' or ']'");
+                pos++;
+                break;
             }
         }
-        else if (*array_begin == '{') // json对象
+        if (nodes)
         {
-            JsonObject jsobj;
-            bool flag;
-            array_begin = jsobj.parser_from_array(array_begin, array_end, flag);
-            parser_array_check(array_begin, array_end);
-            if (flag)
-                insert(key, jsobj);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
+            nodes[index].type = is_object ? TYPE_OBJECT : TYPE_ARRAY;
+            nodes[index].size = size;
+            nodes[index].span = count - index;
         }
-        else if (*array_begin == '[') // json数组
+        return;
+    }
+    switch (c)
+    {
+    case '\"': // 字符串类型
+    {
+        ulong offset = 0, length = 0;
+        pos++;
+        parse_string(offset, length);
+        if (nodes)
         {
-            JsonArray jsary;
-            bool flag;
-            array_begin = jsary.parser_from_array(array_begin, array_end, flag);
-            parser_array_check(array_begin, array_end);
-            if (flag)
-                insert(key, jsary);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
+            nodes[index].type = TYPE_STRING;
+            nodes[index].offset = offset;
+            nodes[index].length = length;
         }
-        else if (*array_begin == 'n') // null
+        break;
+    }
+    case 't': // 布尔类型，true
+    case 'f': // 布尔类型，false
+        parse_literal(c == 't' ? "true" : "false");
+        if (nodes)
         {
-            char tmp[5];
-            memcpy(tmp, array_begin, 4);
-            tmp[4] = 0;
-            if (strcmp(tmp, "null") == 0)
-            {
-                position[key] = {TYPE_NULL, 0};
-            }
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 4;
-            parser_array_check(array_begin, array_end);
+            nodes[index].type = TYPE_BOOLEAN;
+            nodes[index].size = c == 't';
         }
-        else // 格式错误
+        break;
+    case 'n': // null
+        parse_literal("null");
+        break;
+    default: // 数字类型
+        parse_number(index);
+        break;
+    }
+}
+
+constexpr void Shanhj_Json::StaticParser::parse_string(ulong &offset, ulong &length)
+{
+    offset = used;
+    while (text[pos] != '\"')
+    {
+        char c = text[pos++];
+        check(c != 0, "unterminated string");
+        if (c == '\\') // 转义字符，与get_binary_from_text支持的范围相同
         {
-            result = false;
-            return array_begin;
+            char e = text[pos++];
+            switch (e)
+            {
+            case 'n':
+                c = '\n';
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case '\"':
+            case '\\':
+            case '/':
+                c = e;
+                break;
+            default:
+                check(false, "bad escape character");
+            }
         }
-        value_order++;
-        if (!skip_space(array_begin, array_end))
+        if (chars) chars[used] = c;
+        used++;
+    }
+    pos++;
+    length = used - offset;
+}
+
+constexpr void Shanhj_Json::StaticParser::parse_number(ulong index)
+{
+    ulong begin = pos;
+    bool negative = text[pos] == '-';
+    if (negative) pos++;
+    check(text[pos] >= '0' && text[pos] <= '9', "expected value");
+    // mantissa记录有效数字，超过19位后不再累加，只用于判断能否精确转换
+    uint64_t mantissa = 0;
+    long digits = 0, exponent = 0;
+    bool is_double = false;
+    if (text[pos] == '0') // 0开头，后面不能再跟数字
+        pos++;
+    else
+    {
+        for (; text[pos] >= '0' && text[pos] <= '9'; pos++)
         {
-            result = false;
-            return array_begin;
+            if (digits < 19) mantissa = mantissa * 10 + (text[pos] - '0');
+            else exponent++;
+            digits++;
         }
-        if (*array_begin == '}')
-            break;
-        if (*array_begin == ',')
+    }
+    if (text[pos] == '.') // 小数部分
+    {
+        is_double = true;
+        pos++;
+        check(text[pos] >= '0' && text[pos] <= '9', "expected digit");
+        for (; text[pos] >= '0' && text[pos] <= '9'; pos++)
         {
-            array_begin++;
-            parser_array_check(array_begin, array_end);
-            continue;
+            if (mantissa == 0 && text[pos] == '0') // 前导0不计入有效数字
+            {
+                exponent--;
+                continue;
+            }
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (text[pos] - '0');
+                exponent--;
+            }
+            digits++;
         }
+    }
+    if (text[pos] == 'e' || text[pos] == 'E') // 指数部分
+    {
+        is_double = true;
+        pos++;
+        bool negative_exp = text[pos] == '-';
+        if (text[pos] == '+' || text[pos] == '-') pos++;
+        check(text[pos] >= '0' && text[pos] <= '9', "expected digit");
+        long value = 0;
+        for (; text[pos] >= '0' && text[pos] <= '9'; pos++)
         {
-            result = false;
-            return array_begin;
+            if (value < 100000) value = value * 10 + (text[pos] - '0');
         }
+        exponent += negative_exp ? -value : value;
+    }
+    if (!nodes) return;
+    static_node &node = nodes[index];
+    node.offset = used;
+    node.length = pos - begin;
+    for (ulong i = begin; i < pos; i++) // 保留原文，不能在编译期精确转换时在读取时转换
+        chars[used++] = text[i];
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if (!is_double && digits <= 19 && exponent == 0 && mantissa <= limit)
+    {
+        node.type = TYPE_INT;
+        node.int_value = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+        return;
+    }
+    node.type = TYPE_DOUBLE; // 超出int64_t范围的整数按浮点数处理
+    // 有效数字不超过15位并且10的指数不超过22时，两者都能用double精确表示，一次乘除的结果就是正确舍入的值
+    if (digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        double scale = 1;
+        for (long i = 0; i < (exponent < 0 ? -exponent : exponent); i++)
+            scale *= 10;
+        double value = exponent < 0 ? mantissa / scale : mantissa * scale;
+        node.double_value = negative ? -value : value;
+        node.exact = true;
+    }
+}
+
+constexpr void Shanhj_Json::StaticParser::parse_literal(const char *literal)
+{
+    for (; *literal; literal++, pos++)
+        check(text[pos] == *literal, "bad literal");
+}
+
+constexpr Shanhj_Json::ulong Shanhj_Json::static_node_count(const char *text)
+{
+    return StaticParser(text, nullptr, nullptr).run();
+}
+
+Shanhj_Json::value_type Shanhj_Json::StaticValue::type() const
+{
+    return node->type;
+}
+
+Shanhj_Json::ulong Shanhj_Json::StaticValue::size() const
+{
+    return node->type == TYPE_OBJECT || node->type == TYPE_ARRAY ? node->size : 0;
+}
+
+bool Shanhj_Json::StaticValue::get_string(string_view key, string_view &result) const
+{
+    return read_string(find(key), result);
+}
+
+bool Shanhj_Json::StaticValue::get_boolean(string_view key, bool &result) const
+{
+    auto value = find(key);
+    if (!value || value->type != TYPE_BOOLEAN) return false;
+    result = value->size;
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_int(string_view key, int64_t &result) const
+{
+    auto value = find(key);
+    if (!value || value->type != TYPE_INT) return false;
+    result = value->int_value;
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_double(string_view key, double &result) const
+{
+    return read_double(find(key), result);
+}
+
+bool Shanhj_Json::StaticValue::get_object(string_view key, StaticValue &result) const
+{
+    auto value = find(key);
+    if (!value || value->type != TYPE_OBJECT) return false;
+    result = StaticValue(value, chars);
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_array(string_view key, StaticValue &result) const
+{
+    auto value = find(key);
+    if (!value || value->type != TYPE_ARRAY) return false;
+    result = StaticValue(value, chars);
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_string(ulong index, string_view &result) const
+{
+    return read_string(at(index), result);
+}
+
+bool Shanhj_Json::StaticValue::get_boolean(ulong index, bool &result) const
+{
+    auto value = at(index);
+    if (!value || value->type != TYPE_BOOLEAN) return false;
+    result = value->size;
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_int(ulong index, int64_t &result) const
+{
+    auto value = at(index);
+    if (!value || value->type != TYPE_INT) return false;
+    result = value->int_value;
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_double(ulong index, double &result) const
+{
+    return read_double(at(index), result);
+}
+
+bool Shanhj_Json::StaticValue::get_object(ulong index, StaticValue &result) const
+{
+    auto value = at(index);
+    if (!value || value->type != TYPE_OBJECT) return false;
+    result = StaticValue(value, chars);
+    return true;
+}
+
+bool Shanhj_Json::StaticValue::get_array(ulong index, StaticValue &result) const
+{
+    auto value = at(index);
+    if (!value || value->type != TYPE_ARRAY) return false;
+    result = StaticValue(value, chars);
+    return true;
+}
+
+const Shanhj_Json::static_node *Shanhj_Json::StaticValue::find(string_view key) const
+{
+    if (node->type != TYPE_OBJECT) return nullptr;
+    const static_node *found = nullptr;
+    const static_node *child = node + 1;
+    for (ulong i = 0; i < node->size; i++, child += child->span)
+    {
+        if (string_view(chars + child->key_offset, child->key_length) == key) found = child;
     }
-    array_begin++;
-    result = true;
-    return array_begin;
+    return found;
 }
 
-void Shanhj_Json::JsonArray::insert(const string &value)
+const Shanhj_Json::static_node *Shanhj_Json::StaticValue::at(ulong index) const
 {
-    position.push_back({TYPE_STRING, v_string.size()});
-    v_string.push_back(value);
+    if (node->type != TYPE_ARRAY || index >= node->size) return nullptr;
+    const static_node *child = node + 1;
+    while (index--)
+        child += child->span;
+    return child;
 }
 
-void Shanhj_Json::JsonArray::insert(const char *value)
+bool Shanhj_Json::StaticValue::read_string(const static_node *value, string_view &result) const
 {
-    position.push_back({TYPE_STRING, v_string.size()});
-    v_string.push_back(value);
+    if (!value || value->type != TYPE_STRING) return false;
+    result = string_view(chars + value->offset, value->length);
+    return true;
 }
 
-void Shanhj_Json::JsonArray::insert(bool value)
+bool Shanhj_Json::StaticValue::read_double(const static_node *value, double &result) const
 {
-    position.push_back({TYPE_BOOLEAN, value});
+    if (!value || value->type != TYPE_DOUBLE) return false;
+    if (value->exact)
+    {
+        result = value->double_value;
+        return true;
+    }
+    string text(chars + value->offset, value->length); // strtod需要以'\0'结尾的字符串
+    result = strtod(text.c_str(), nullptr);
+    return true;
 }
-void Shanhj_Json::JsonArray::insert(int value)
+
+Shanhj_Json::ulong Shanhj_Json::frozen_bucket(uint64_t hash, ulong bucket_count)
 {
-    position.push_back({TYPE_INT, v_int.size()});
-    v_int.push_back(value);
+    return (hash >> 32) * bucket_count >> 32;
 }
-void Shanhj_Json::JsonArray::insert(int64_t value)
+
+Shanhj_Json::ulong Shanhj_Json::frozen_slot(uint64_t hash, uint32_t displacement, ulong count)
 {
-    position.push_back({TYPE_INT, v_int.size()});
-    v_int.push_back(value);
+    return (hash_mix(hash + displacement) >> 32) * count >> 32;
 }
-void Shanhj_Json::JsonArray::insert(double value)
+
+Shanhj_Json::FrozenJson Shanhj_Json::JsonObject::freeze() const
 {
-    position.push_back({TYPE_DOUBLE, v_double.size()});
-    v_double.push_back(value);
+    FrozenJson result;
+    result.build(*this);
+    return result;
 }
-void Shanhj_Json::JsonArray::insert(const JsonObject &value)
+
+Shanhj_Json::FrozenJson Shanhj_Json::JsonArray::freeze() const
 {
-    position.push_back({TYPE_OBJECT, v_object.size()});
-    v_object.push_back(value);
+    FrozenJson result;
+    result.build(*this);
+    return result;
 }
 
-void Shanhj_Json::JsonArray::insert(const JsonArray &value)
+Shanhj_Json::FrozenValue::FrozenValue(const frozen_value *value, const char *image, const char *chars)
+    : value(value), image(image), chars(chars)
 {
-    position.push_back({TYPE_ARRAY, v_array.size()});
-    v_array.push_back(value);
 }
 
-bool Shanhj_Json::JsonArray::get_string(ulong index, string &result)
+Shanhj_Json::value_type Shanhj_Json::FrozenValue::type() const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_STRING) return false;
-    result = v_string[iter->second];
+    return (value_type)value->type;
+}
+
+Shanhj_Json::ulong Shanhj_Json::FrozenValue::size() const
+{
+    return value->type == TYPE_OBJECT || value->type == TYPE_ARRAY ? value->size : 0;
+}
+
+bool Shanhj_Json::FrozenValue::get_string(string_view key, string_view &result) const
+{
+    return read_string(find(key), result);
+}
+
+bool Shanhj_Json::FrozenValue::get_boolean(string_view key, bool &result) const
+{
+    auto found = find(key);
+    if (!found || found->type != TYPE_BOOLEAN) return false;
+    result = found->size;
     return true;
 }
-bool Shanhj_Json::JsonArray::get_boolean(ulong index, bool &result)
+
+bool Shanhj_Json::FrozenValue::get_int(string_view key, int64_t &result) const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_BOOLEAN) return false;
-    result = iter->second;
+    auto found = find(key);
+    if (!found || found->type != TYPE_INT) return false;
+    result = (int64_t)found->data;
     return true;
 }
-bool Shanhj_Json::JsonArray::get_int(ulong index, int64_t &result)
+
+bool Shanhj_Json::FrozenValue::get_double(string_view key, double &result) const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_INT) return false;
-    result = v_int[iter->second];
+    auto found = find(key);
+    if (!found || found->type != TYPE_DOUBLE) return false;
+    memcpy(&result, &found->data, sizeof(double));
     return true;
 }
-bool Shanhj_Json::JsonArray::get_double(ulong index, double &result)
+
+bool Shanhj_Json::FrozenValue::get_object(string_view key, FrozenValue &result) const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_DOUBLE) return false;
-    result = v_double[iter->second];
+    return read_container(find(key), TYPE_OBJECT, result);
+}
+
+bool Shanhj_Json::FrozenValue::get_array(string_view key, FrozenValue &result) const
+{
+    return read_container(find(key), TYPE_ARRAY, result);
+}
+
+bool Shanhj_Json::FrozenValue::get_string(ulong index, string_view &result) const
+{
+    return read_string(at(index), result);
+}
+
+bool Shanhj_Json::FrozenValue::get_boolean(ulong index, bool &result) const
+{
+    auto found = at(index);
+    if (!found || found->type != TYPE_BOOLEAN) return false;
+    result = found->size;
     return true;
 }
-bool Shanhj_Json::JsonArray::get_object(ulong index, JsonObject &result)
+
+bool Shanhj_Json::FrozenValue::get_int(ulong index, int64_t &result) const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_OBJECT) return false;
-    result = v_object[iter->second];
+    auto found = at(index);
+    if (!found || found->type != TYPE_INT) return false;
+    result = (int64_t)found->data;
     return true;
 }
 
-bool Shanhj_Json::JsonArray::get_array(ulong index, JsonArray &result)
+bool Shanhj_Json::FrozenValue::get_double(ulong index, double &result) const
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    if (iter->first != TYPE_ARRAY) return false;
-    result = v_array[iter->second];
+    auto found = at(index);
+    if (!found || found->type != TYPE_DOUBLE) return false;
+    memcpy(&result, &found->data, sizeof(double));
     return true;
 }
 
-std::string Shanhj_Json::JsonArray::output_to_string(long indent)
+bool Shanhj_Json::FrozenValue::get_object(ulong index, FrozenValue &result) const
 {
-    string result;
-    result += '[';
-    if (position.size())
+    return read_container(at(index), TYPE_OBJECT, result);
+}
+
+bool Shanhj_Json::FrozenValue::get_array(ulong index, FrozenValue &result) const
+{
+    return read_container(at(index), TYPE_ARRAY, result);
+}
+
+const Shanhj_Json::frozen_value *Shanhj_Json::FrozenValue::find(string_view key) const
+{
+    if (value->type != TYPE_OBJECT || value->size == 0) return nullptr;
+    auto header = (const frozen_object *)(image + value->data);
+    auto entries = (const frozen_entry *)(header + 1);
+    auto displacements = (const uint32_t *)(entries + value->size);
+    uint64_t hash = hash_bytes(key.data(), key.size(), header->seed);
+    const frozen_entry &entry = entries[frozen_slot(hash, displacements[frozen_bucket(hash, header->bucket_count)], value->size)];
+    if (entry.tag != (uint32_t)hash || entry.key_length != key.size() || memcmp(chars + entry.key_offset, key.data(), key.size()) != 0)
+        return nullptr;
+    return &entry.value;
+}
+
+const Shanhj_Json::frozen_value *Shanhj_Json::FrozenValue::at(ulong index) const
+{
+    if (value->type != TYPE_ARRAY || index >= value->size) return nullptr;
+    return (const frozen_value *)(image + value->data) + index;
+}
+
+bool Shanhj_Json::FrozenValue::read_string(const frozen_value *found, string_view &result) const
+{
+    if (!found || found->type != TYPE_STRING) return false;
+    result = string_view(chars + found->data, found->size);
+    return true;
+}
+
+bool Shanhj_Json::FrozenValue::read_container(const frozen_value *found, value_type type, FrozenValue &result) const
+{
+    if (!found || found->type != type) return false;
+    result = FrozenValue(found, image, chars);
+    return true;
+}
+
+Shanhj_Json::FrozenJson::~FrozenJson()
+{
+    release();
+}
+
+Shanhj_Json::FrozenJson::FrozenJson(FrozenJson &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+Shanhj_Json::FrozenJson &Shanhj_Json::FrozenJson::operator=(FrozenJson &&other) noexcept
+{
+    if (this == &other) return *this;
+    release();
+    // vector移动后缓冲区的地址不变，映射的地址也不变，指向映像的指针可以直接转移
+    owned = std::move(other.owned);
+    mapping = other.mapping;
+    mapping_size = other.mapping_size;
+    image_size = other.image_size;
+    FrozenValue::operator=(other);
+    other.owned.clear();
+    other.mapping = nullptr;
+    other.release();
+    return *this;
+}
+
+bool Shanhj_Json::FrozenJson::attach(const char *data, ulong size)
+{
+    release();
+    return open(data, size);
+}
+
+bool Shanhj_Json::FrozenJson::map(const string &path)
+{
+    release();
+#ifdef SHANHJ_JSON_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void *address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        address = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // 映射建立后不再需要文件描述符
+    if (address == MAP_FAILED) return false;
+    mapping = address;
+    mapping_size = info.st_size;
+    if (open((const char *)address, info.st_size)) return true;
+#else
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    bool loaded = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (loaded)
     {
-        if (indent >= 0)
-        {
-            result += '\n';
-            for (int i = 0; i < indent + 4; i++) // 缩进
-                result += ' ';
-        }
-        bool flag = 0;
-        for (auto entry : position)
+        owned.resize((size + sizeof(cache_line) - 1) / sizeof(cache_line));
+        loaded = fread(owned.data(), 1, size, file) == (ulong)size;
+    }
+    fclose(file);
+    if (loaded && open((const char *)owned.data(), size)) return true;
+#endif
+    release();
+    return false;
+}
+
+bool Shanhj_Json::FrozenJson::save(const string &path) const
+{
+    if (!image) return false;
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool saved = fwrite(image, 1, image_size, file) == image_size;
+    return fclose(file) == 0 && saved;
+}
+
+const char *Shanhj_Json::FrozenJson::data() const
+{
+    return image;
+}
+
+Shanhj_Json::ulong Shanhj_Json::FrozenJson::size_in_bytes() const
+{
+    return image_size;
+}
+
+template <typename Root>
+void Shanhj_Json::FrozenJson::build(const Root &root)
+{
+    release();
+    builder b;
+    b.blocks.resize(sizeof(frozen_header));
+    frozen_header header = {};
+    memcpy(header.magic, "SHJFRZ1", 8);
+    header.byte_order = 0x0102030405060708ull;
+    header.root = freeze_container(b, root);
+    header.chars_offset = reserve(b, b.chars.size(), 8);
+    memcpy(&b.blocks[header.chars_offset], b.chars.data(), b.chars.size());
+    header.chars_size = b.chars.size();
+    header.size = b.blocks.size();
+    memcpy(&b.blocks[0], &header, sizeof(header));
+    owned.resize((b.blocks.size() + sizeof(cache_line) - 1) / sizeof(cache_line));
+    memcpy(owned.data(), b.blocks.data(), b.blocks.size());
+    open((const char *)owned.data(), b.blocks.size());
+}
+
+Shanhj_Json::frozen_value Shanhj_Json::FrozenJson::freeze_container(builder &b, const JsonObject &object)
+{
+    frozen_value result;
+    result.type = TYPE_OBJECT;
+    ulong count = object.position.size();
+    if (count > UINT32_MAX) throw length_error("frozen object too large");
+    result.size = count;
+    if (count == 0) return result;
+
+    // 最小完美哈希：键先按哈希值分到count/2个桶中，从大桶开始为每个桶寻找一个位移值，
+    // 使桶中的键都落在还没有被占用的不同位置上，查找时只需要一次哈希和一次位移值的查表
+    vector<pair<const string *, const pair<value_type, ulong> *>> members;
+    members.reserve(count);
+    for (auto &member : object.position)
+        members.push_back({&member.first, &member.second});
+    ulong bucket_count = max<ulong>(1, count / 2);
+    uint64_t seed = 0;
+    vector<uint64_t> hashes(count);
+    vector<uint32_t> displacements(bucket_count);
+    vector<ulong> slots(count);
+    while (true)
+    {
+        for (ulong i = 0; i < count; i++)
+            hashes[i] = hash_bytes(members[i].first->data(), members[i].first->size(), seed);
+        vector<vector<ulong>> buckets(bucket_count);
+        for (ulong i = 0; i < count; i++)
+            buckets[frozen_bucket(hashes[i], bucket_count)].push_back(i);
+        vector<ulong> order(bucket_count);
+        for (ulong i = 0; i < bucket_count; i++)
+            order[i] = i;
+        stable_sort(order.begin(), order.end(), [&](ulong x, ulong y) { return buckets[x].size() > buckets[y].size(); });
+        vector<bool> taken(count);
+        bool placed = true;
+        for (ulong bucket : order)
         {
-            if (!flag)
-                flag = 1;
-            else
+            auto &keys = buckets[bucket];
+            if (keys.empty()) break;
+            // 哈希值完全相同的两个键无论位移值是多少都会冲突，只能换一个种子
+            for (ulong i = 1; i < keys.size() && placed; i++)
+                for (ulong j = 0; j < i && placed; j++)
+                    placed = hashes[keys[i]] != hashes[keys[j]];
+            if (!placed) break;
+            for (uint32_t displacement = 0;; displacement++)
             {
-                result += ',';
-                if (indent >= 0)
+                ulong i = 0;
+                for (; i < keys.size(); i++)
                 {
-                    result += '\n';
-                    for (int i = 0; i < indent + 4; i++) // 缩进
-                        result += ' ';
+                    slots[keys[i]] = frozen_slot(hashes[keys[i]], displacement, count);
+                    bool conflict = taken[slots[keys[i]]];
+                    for (ulong j = 0; j < i && !conflict; j++)
+                        conflict = slots[keys[j]] == slots[keys[i]];
+                    if (conflict) break;
                 }
-            }
-            switch (entry.first)
-            {
-            case TYPE_STRING:
-                result += '\"';
-                result += binary_to_text(v_string[entry.second]);
-                result += '\"';
-                break;
-            case TYPE_BOOLEAN:
-                result += entry.second ? "true" : "false";
-                break;
-            case TYPE_INT:
-                result += to_string(v_int[entry.second]);
-                break;
-            case TYPE_DOUBLE:
-                result += to_string(v_double[entry.second]);
-                break;
-            case TYPE_OBJECT:
-                result += v_object[entry.second].output_to_string(indent + 4);
-                break;
-            case TYPE_ARRAY:
-                result += v_array[entry.second].output_to_string(indent + 4);
-                break;
-            case TYPE_NULL:
-                result += "null";
-                break;
-            default:
+                if (i < keys.size()) continue;
+                for (ulong key : keys)
+                    taken[slots[key]] = true;
+                displacements[bucket] = displacement;
                 break;
             }
         }
-        if (indent >= 0)
-        {
-            result += '\n';
-            for (int i = 0; i < indent; i++)
-                result += ' ';
-        }
+        if (placed) break;
+        seed++;
     }
-    result += "]";
+
+    // 先预留整个数据块，子容器的数据块按表项的顺序排在它之后
+    ulong block_size = sizeof(frozen_object) + count * sizeof(frozen_entry) + bucket_count * sizeof(uint32_t);
+    uint64_t block = reserve(b, block_size, sizeof(frozen_entry)); // 表项按32字节对齐
+    frozen_object header = {};
+    header.seed = seed;
+    header.bucket_count = bucket_count;
+    memcpy(&b.blocks[block], &header, sizeof(header));
+    uint64_t entries = block + sizeof(frozen_object);
+    memcpy(&b.blocks[entries + count * sizeof(frozen_entry)], displacements.data(), bucket_count * sizeof(uint32_t));
+    vector<ulong> member_at(count);
+    for (ulong i = 0; i < count; i++)
+        member_at[slots[i]] = i;
+    for (ulong slot = 0; slot < count; slot++)
+    {
+        ulong i = member_at[slot];
+        const string &key = *members[i].first;
+        if (key.size() > UINT32_MAX) throw length_error("frozen key too long");
+        frozen_entry entry = {};
+        auto inserted = b.keys.emplace(key, b.chars.size());
+        if (inserted.second) b.chars += key;
+        entry.key_offset = inserted.first->second;
+        entry.key_length = key.size();
+        entry.tag = (uint32_t)hashes[i];
+        entry.value = freeze_value(b, object, *members[i].second); // 可能使blocks重新分配，只通过偏移写入
+        memcpy(&b.blocks[entries + slot * sizeof(frozen_entry)], &entry, sizeof(entry));
+    }
+    result.data = block;
     return result;
 }
 
-void Shanhj_Json::JsonArray::clear()
+Shanhj_Json::frozen_value Shanhj_Json::FrozenJson::freeze_container(builder &b, const JsonArray &array)
 {
-    position.clear();
-    v_array.clear();
-    v_double.clear();
-    v_int.clear();
-    v_object.clear();
-    v_string.clear();
+    frozen_value result;
+    result.type = TYPE_ARRAY;
+    ulong count = array.size();
+    if (count > UINT32_MAX) throw length_error("frozen array too large");
+    result.size = count;
+    if (count == 0) return result;
+    uint64_t block = reserve(b, count * sizeof(frozen_value), alignof(frozen_value));
+    ulong index = 0;
+    array.for_each_entry([&](const pair<value_type, ulong> &item) {
+        frozen_value value = freeze_value(b, array, item);
+        memcpy(&b.blocks[block + index++ * sizeof(frozen_value)], &value, sizeof(value));
+    });
+    result.data = block;
+    return result;
 }
 
-char *Shanhj_Json::JsonArray::parser_from_array(char *array_begin, char *array_end, bool &result)
+template <typename C>
+Shanhj_Json::frozen_value Shanhj_Json::FrozenJson::freeze_value(builder &b, const C &c, const pair<value_type, ulong> &value)
 {
-    if (array_begin >= array_end)
-    {
-        result = false;
-        return array_begin;
-    }
-    ulong value_order = 0;
-    clear();
-    if (!skip_space(array_begin, array_end))
+    frozen_value result;
+    result.type = value.first;
+    switch (value.first)
     {
-        result = false;
-        return array_begin;
-    }
-    if (*array_begin != '[')
+    case TYPE_STRING:
     {
-        result = false;
-        return array_begin;
+        const string &text = c.v_string[value.second];
+        if (text.size() > UINT32_MAX) throw length_error("frozen string too long");
+        result.size = text.size();
+        result.data = b.chars.size();
+        b.chars += text;
+        break;
     }
-    array_begin++;
-    parser_array_check(array_begin, array_end);
-    while (array_begin < array_end)
+    case TYPE_INT:
+        result.data = (uint64_t)c.v_int[value.second];
+        break;
+    case TYPE_DOUBLE:
+        memcpy(&result.data, &c.v_double[value.second], sizeof(double));
+        break;
+    case TYPE_NUMBER: // 保留原文的数字按读取时的规则转换为整数或浮点数
     {
-        if (!skip_space(array_begin, array_end))
-        {
-            result = false;
-            return array_begin;
-        }
-        if (*array_begin == '\"') // 字符串类型
-        {
-            array_begin++;
-            parser_array_check(array_begin, array_end);
-            string str;
-            if (!get_binary_from_text(array_begin, array_end, str))
-            {
-                result = false;
-                return array_begin;
-            }
-            insert(str);
-        }
-        else if (*array_begin == 't') // 布尔类型，true
-        {
-            char tmp[5];
-            memcpy(tmp, array_begin, 4);
-            tmp[4] = 0;
-            if (strcmp(tmp, "true") == 0)
-                insert(true);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 4;
-            parser_array_check(array_begin, array_end);
-        }
-        else if (*array_begin == 'f') // 布尔类型，false
-        {
-            char tmp[6];
-            memcpy(tmp, array_begin, 5);
-            tmp[5] = 0;
-            if (strcmp(tmp, "false") == 0)
-                insert(false);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 5;
-            parser_array_check(array_begin, array_end);
-        }
-        else if ((*array_begin >= '0' && *array_begin <= '9') || *array_begin == '-') // 数字类型
+        const raw_number &number = c.v_number[value.second];
+        int64_t int_value;
+        double double_value;
+        if (raw_to_int(c.number_text, number, int_value))
         {
-            string num;
-            if (*array_begin == '-')
-            {
-                num += '-';
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-            }
-            if (*array_begin == '0') // 0开头
-            {
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-                if (*array_begin != '.' && (*array_begin < '0' || *array_begin > '9'))
-                    insert(0);
-                else if (*array_begin == '.')
-                {
-                    num = "0.";
-                    array_begin++;
-                    parser_array_check(array_begin, array_end);
-                    bool flag = 0;
-                    while (*array_begin >= '0' && *array_begin <= '9')
-                    {
-                        flag = 1;
-                        num += *array_begin;
-                        array_begin++;
-                        parser_array_check(array_begin, array_end);
-                    }
-                    if (!flag)
-                    {
-                        result = false;
-                        return array_begin;
-                    }
-                    insert(stod(num));
-                }
-            }
-            else if (*array_begin >= '1' && *array_begin <= '9')
-            {
-                ulong dot_cnt = 0; // 统计小数点个数
-                num += *array_begin;
-                array_begin++;
-                parser_array_check(array_begin, array_end);
-                while ((*array_begin >= '0' && *array_begin <= '9') || *array_begin == '.')
-                {
-                    if (*array_begin == '.') dot_cnt++;
-                    num += *array_begin;
-                    array_begin++;
-                    parser_array_check(array_begin, array_end);
-                }
-                if (dot_cnt > 1 || num.back() == '.')
-                {
-                    result = false;
-                    return array_begin;
-                }
-                if (dot_cnt == 1) // 有小数点，为浮点数
-                    insert(stod(num));
-                else
-                    insert(stoll(num));
-            }
-            else
-            {
-                result = false;
-                return array_begin;
-            }
+            result.type = TYPE_INT;
+            result.data = (uint64_t)int_value;
         }
-        else if (*array_begin == '{') // json对象
+        else
         {
-            JsonObject jsobj;
-            bool flag;
-            array_begin = jsobj.parser_from_array(array_begin, array_end, flag);
-            parser_array_check(array_begin, array_end);
-            if (flag)
-                insert(jsobj);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
+            raw_to_double(c.number_text, number, double_value);
+            result.type = TYPE_DOUBLE;
+            memcpy(&result.data, &double_value, sizeof(double));
         }
-        else if (*array_begin == '[') // json数组
+        break;
+    }
+    case TYPE_BOOLEAN:
+        result.size = value.second != 0;
+        break;
+    case TYPE_OBJECT:
+        return freeze_container(b, *c.v_object[value.second]);
+    case TYPE_ARRAY:
+        return freeze_container(b, *c.v_array[value.second]);
+    default:
+        break;
+    }
+    return result;
+}
+
+uint64_t Shanhj_Json::FrozenJson::reserve(builder &b, ulong bytes, ulong align)
+{
+    uint64_t offset = (b.blocks.size() + align - 1) / align * align;
+    b.blocks.resize(offset + bytes);
+    return offset;
+}
+
+bool Shanhj_Json::FrozenJson::open(const char *data, ulong size)
+{
+    frozen_header header;
+    if (!data || size < sizeof(header) || (uintptr_t)data % alignof(frozen_header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "SHJFRZ1", 8) != 0 || header.byte_order != 0x0102030405060708ull || header.size != size)
+        return false;
+    if (header.chars_offset < sizeof(header) || header.chars_offset > size || header.chars_size != size - header.chars_offset)
+        return false;
+    if (header.root.type != TYPE_OBJECT && header.root.type != TYPE_ARRAY) return false;
+
+    // 数据块按先序排列并且互不重叠，按先序遍历时每个数据块都必须从上一个数据块结束之后开始，
+    // 这样每个数据块只会被检查一次，也不会出现环，用显式的栈代替递归
+    const char *chars = data + header.chars_offset;
+    uint64_t cursor = sizeof(header);
+    vector<const frozen_value *> pending;
+    auto check_value = [&](const frozen_value &value) {
+        switch (value.type)
         {
-            JsonArray jsary;
-            bool flag;
-            array_begin = jsary.parser_from_array(array_begin, array_end, flag);
-            parser_array_check(array_begin, array_end);
-            if (flag)
-                insert(jsary);
-            else
-            {
-                result = false;
-                return array_begin;
-            }
+        case TYPE_STRING:
+            return value.data <= header.chars_size && value.size <= header.chars_size - value.data;
+        case TYPE_BOOLEAN:
+            return value.size <= 1;
+        case TYPE_INT:
+        case TYPE_DOUBLE:
+        case TYPE_NULL:
+            return true;
+        case TYPE_OBJECT:
+        case TYPE_ARRAY:
+            return true; // 数据块在出栈时检查
+        default:
+            return false;
         }
-        else if (*array_begin == 'n') // null
+    };
+    pending.push_back(&((const frozen_header *)data)->root);
+    while (!pending.empty())
+    {
+        const frozen_value &value = *pending.back();
+        pending.pop_back();
+        if (value.size == 0) continue;
+        if (value.data < cursor || value.data > header.chars_offset) return false;
+        uint64_t space = header.chars_offset - value.data;
+        if (value.type == TYPE_ARRAY)
         {
-            char tmp[5];
-            memcpy(tmp, array_begin, 4);
-            tmp[4] = 0;
-            if (strcmp(tmp, "null") == 0)
+            if (value.data % alignof(frozen_value) || space / sizeof(frozen_value) < value.size) return false;
+            auto items = (const frozen_value *)(data + value.data);
+            for (ulong i = value.size; i-- > 0;)
             {
-                position.push_back({TYPE_NULL, 0});
+                if (!check_value(items[i])) return false;
+                if (items[i].type == TYPE_OBJECT || items[i].type == TYPE_ARRAY) pending.push_back(&items[i]);
             }
-            else
-            {
-                result = false;
-                return array_begin;
-            }
-            array_begin += 4;
-            parser_array_check(array_begin, array_end);
-        }
-        else if (*array_begin == ']' && value_order == 0)
-            break;
-        else // 格式错误
-        {
-            result = false;
-            return array_begin;
-        }
-        if (!skip_space(array_begin, array_end))
-        {
-            result = false;
-            return array_begin;
+            cursor = value.data + value.size * sizeof(frozen_value);
+            continue;
         }
-        value_order++;
-        if (*array_begin == ']')
-            break;
-        if (*array_begin == ',')
+        if (value.data % alignof(frozen_object) || space < sizeof(frozen_object)) return false;
+        auto object = (const frozen_object *)(data + value.data);
+        if (object->bucket_count == 0) return false;
+        uint64_t block_size = sizeof(frozen_object) + (uint64_t)value.size * sizeof(frozen_entry) + (uint64_t)object->bucket_count * sizeof(uint32_t);
+        if (space < block_size) return false;
+        auto entries = (const frozen_entry *)(object + 1);
+        for (ulong i = value.size; i-- > 0;)
         {
-            array_begin++;
-            parser_array_check(array_begin, array_end);
-            continue;
+            const frozen_entry &entry = entries[i];
+            if (entry.key_offset > header.chars_size || entry.key_length > header.chars_size - entry.key_offset) return false;
+            if (!check_value(entry.value)) return false;
+            if (entry.value.type == TYPE_OBJECT || entry.value.type == TYPE_ARRAY) pending.push_back(&entry.value);
         }
-        result = false;
-        return array_begin;
+        cursor = value.data + block_size;
     }
-    array_begin++;
-    result = true;
-    return array_begin;
-}
-
-Shanhj_Json::ulong Shanhj_Json::JsonArray::size()
-{
-    return position.size();
+    image = data;
+    image_size = size;
+    this->chars = chars;
+    value = &((const frozen_header *)data)->root;
+    return true;
 }
 
-bool Shanhj_Json::JsonArray::remove(ulong index)
+void Shanhj_Json::FrozenJson::release()
 {
-    if (index >= position.size()) return false;
-    auto iter = position.begin();
-    while (index--)
-        iter++;
-    position.erase(iter);
-    return true;
+#ifdef SHANHJ_JSON_HAS_MMAP
+    if (mapping) munmap(mapping, mapping_size);
+#endif
+    mapping = nullptr;
+    mapping_size = 0;
+    owned.clear();
+    owned.shrink_to_fit();
+    image = nullptr;
+    image_size = 0;
+    chars = nullptr;
+    value = &null_value;
 }
 
 #endif
\ No newline at end of file
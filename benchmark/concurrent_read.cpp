@@ -0,0 +1,105 @@
+// 多线程并发读取同一个文档的吞吐量测试，另外测试开启输出缓存后一个线程输出、其他线程同时读取的情况
+// 可以加上-fsanitize=thread编译，检查并发读取和输出之间没有数据竞争
+// 编译：g++ -std=c++17 -O2 -pthread concurrent_read.cpp -o concurrent_read
+// 运行：./concurrent_read [最大线程数]
+#include "../Shanhj_Json.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+using namespace Shanhj_Json;
+
+const int KEY_COUNT = 10000;
+const int LOOKUPS_PER_THREAD = 2000000;
+
+// 构造一个有KEY_COUNT个键的配置文档，每个值是一个小对象
+JsonObject build_document()
+{
+    JsonObject doc;
+    for (int i = 0; i < KEY_COUNT; i++)
+    {
+        JsonObject item;
+        item.insert("id", i);
+        item.insert("name", "item" + to_string(i));
+        item.insert("enabled", i % 2 == 0);
+        doc.insert("key" + to_string(i), item);
+    }
+    return doc;
+}
+
+// 用threads个线程在doc中查找，返回每秒的查找次数，with_output为true时另有一个线程同时反复输出doc
+double run_lookups(const JsonObject &doc, const vector<string> &keys, unsigned threads, bool with_output, long &found_count)
+{
+    atomic<long> found(0);
+    atomic<bool> done(false);
+    vector<thread> workers;
+    thread output;
+    if (with_output)
+    {
+        output = thread([&]() {
+            while (!done)
+                doc.output_to_string(-1);
+        });
+    }
+    auto begin = chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            long hit = 0;
+            unsigned index = t * 7919;
+            JsonObject item;
+            for (int i = 0; i < LOOKUPS_PER_THREAD; i++)
+            {
+                index = (index + 104729) % KEY_COUNT;
+                int64_t id;
+                if (doc.get_object(keys[index], item) && item.get_int("id", id) && id == index) hit++;
+            }
+            found += hit;
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    done = true;
+    if (with_output) output.join();
+    found_count = found.load();
+    return (double)threads * LOOKUPS_PER_THREAD / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = argc > 1 ? atoi(argv[1]) : thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+    const JsonObject doc = build_document();
+    vector<string> keys;
+    for (int i = 0; i < KEY_COUNT; i++)
+        keys.push_back("key" + to_string(i));
+
+    vector<unsigned> thread_counts;
+    for (unsigned threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    double base = 0;
+    for (unsigned threads : thread_counts)
+    {
+        long found;
+        double rate = run_lookups(doc, keys, threads, false, found);
+        if (threads == 1) base = rate;
+        printf("threads:%2u lookups/s:%12.0f speedup:%5.2f found:%ld\n", threads, rate, rate / base, found);
+    }
+
+    // 开启输出缓存后，输出线程生成的各层缓存会在get_object拷贝子对象时被读取线程同时拷贝
+    JsonObject cached = build_document();
+    cached.set_output_cache(true);
+    const JsonObject &shared = cached;
+    for (unsigned threads : thread_counts)
+    {
+        long found;
+        double rate = run_lookups(shared, keys, threads, true, found);
+        printf("cached, with output thread, threads:%2u lookups/s:%12.0f found:%ld\n", threads, rate, found);
+    }
+    return 0;
+}
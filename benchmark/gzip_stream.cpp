@@ -0,0 +1,86 @@
+// 对比先把整个gzip文件解压到内存再逐行解析，和用JsonArrayReader边解压边解析NDJSON的耗时与内存占用
+// 编译：g++ -std=c++17 -O2 -pthread -DSHANHJ_JSON_ZLIB gzip_stream.cpp -o gzip_stream -lz
+// 运行：./gzip_stream [ndjson.gz文件]，不指定文件时生成records.ndjson.gz
+#include "../Shanhj_Json.hpp"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace Shanhj_Json;
+
+const int RECORD_COUNT = 500000;
+
+// 生成RECORD_COUNT行记录并压缩写入path
+bool build_file(const char *path)
+{
+    gzFile file = gzopen(path, "wb");
+    if (!file) return false;
+    for (int i = 0; i < RECORD_COUNT; i++)
+    {
+        string id = to_string(i);
+        string line = "{\"id\": " + id + ", \"name\": \"user" + id + "\", \"tags\": [\"a\", \"b\"], \"score\": " +
+                      to_string(i * 0.5) + ", \"active\": " + (i % 3 ? "true" : "false") + "}\n";
+        gzwrite(file, line.data(), line.size());
+    }
+    return gzclose(file) == Z_OK;
+}
+
+// 解压整个文件，再逐行解析，返回记录数
+long decompress_then_parse(const char *path, ulong &peak)
+{
+    gzFile file = gzopen(path, "rb");
+    if (!file) return -1;
+    string text;
+    char buffer[1 << 16];
+    int size;
+    while ((size = gzread(file, buffer, sizeof(buffer))) > 0)
+        text.append(buffer, size);
+    gzclose(file);
+    peak = text.capacity();
+    Parser parser;
+    JsonObject record;
+    bool result = true;
+    long count = 0;
+    char *begin = &text[0], *end = begin + text.size();
+    while (result)
+    {
+        if (!skip_space(begin, end)) break;
+        begin = parser.parse(begin, end, record, result);
+        count += result;
+    }
+    return result ? count : -1;
+}
+
+// 后台线程解压，当前线程逐行解析，返回记录数
+long pipelined(const char *path, ulong chunk_size)
+{
+    JsonArrayReader reader(path, chunk_size, parse_limits(), STREAM_NDJSON, 4);
+    JsonObject record;
+    long count = 0;
+    while (reader.next(record))
+        count++;
+    return reader.failed() ? -1 : count;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "records.ndjson.gz";
+    if (argc == 1 && !build_file(path))
+    {
+        printf("cannot write %s\n", path);
+        return 1;
+    }
+    ulong peak = 0;
+    auto begin = chrono::steady_clock::now();
+    long count = decompress_then_parse(path, peak);
+    double whole = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    printf("decompress then parse: %ld records %.3fs, buffer %lu bytes\n", count, whole, peak);
+    for (ulong chunk_size : {1ul << 16, 1ul << 20})
+    {
+        begin = chrono::steady_clock::now();
+        count = pipelined(path, chunk_size);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        printf("pipelined chunk %7lu: %ld records %.3fs, ring %lu bytes\n", chunk_size, count, seconds, chunk_size * 4);
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+// 对比普通输入和带填充的输入（PaddedBuffer）的解析速度
+// 编译：g++ -std=c++17 -O2 padded_parse.cpp -o padded_parse
+// 运行：./padded_parse [json文件]，不指定文件时使用生成的文档
+#include "../Shanhj_Json.hpp"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace Shanhj_Json;
+
+const int RECORD_COUNT = 200000;
+const int ROUNDS = 10;
+
+// 构造一个由RECORD_COUNT条记录组成的文档，字符串、字面量和数字各占一部分
+string build_document()
+{
+    string doc = "{\"records\": [";
+    for (int i = 0; i < RECORD_COUNT; i++)
+    {
+        if (i) doc += ",";
+        string id = to_string(i);
+        doc += "\n    {\"id\": " + id + ", \"name\": \"user" + id + "\", \"email\": \"user" + id + "@example.com\", ";
+        doc += "\"description\": \"a longer text field that spans several sixteen byte blocks, \\\"quoted\\\"\", ";
+        doc += string("\"active\": ") + (i % 3 ? "true" : "false") + ", \"score\": " + to_string(i * 0.25) + ", \"manager\": null}";
+    }
+    return doc + "\n]}";
+}
+
+// 用同一个Parser解析ROUNDS次，返回每秒解析的字节数
+template <typename Parse>
+double measure(ulong size, Parse parse)
+{
+    parse(); // 预热，填充Parser的节点池
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        parse();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return (double)size * ROUNDS / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    PaddedBuffer padded;
+    if (argc > 1)
+    {
+        if (!padded.load(argv[1]))
+        {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+        padded = PaddedBuffer(build_document());
+    string plain(padded.data(), padded.size());
+
+    Parser parser;
+    JsonObject doc;
+    bool result = false;
+    double plain_rate = measure(plain.size(), [&]() { parser.parse(&plain[0], &plain[0] + plain.size(), doc, result); });
+    if (!result)
+    {
+        printf("parse failed: %s\n", parser.last_error().expected);
+        return 1;
+    }
+    double padded_rate = measure(padded.size(), [&]() { parser.parse(padded, doc, result); });
+    printf("size:%lu bytes\n", padded.size());
+    printf("plain  MB/s:%8.1f\n", plain_rate / 1e6);
+    printf("padded MB/s:%8.1f speedup:%5.2f\n", padded_rate / 1e6, padded_rate / plain_rate);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// 对比output_to_string和不同线程数的output_parallel的输出速度，并检查两者的输出完全相同
+// 编译：g++ -std=c++17 -O2 -pthread parallel_output.cpp -o parallel_output
+// 运行：./parallel_output [最大线程数]
+#include "../Shanhj_Json.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace Shanhj_Json;
+
+const int RECORD_COUNT = 200000;
+const int ROUNDS = 5;
+
+// 构造一个状态文档：大量顶层成员，另外有一个很大的子对象和一个很大的整数数组
+JsonObject build_document()
+{
+    JsonObject doc, sessions;
+    for (int i = 0; i < RECORD_COUNT; i++)
+    {
+        JsonObject record;
+        record.insert("id", i);
+        record.insert("name", "user" + to_string(i));
+        record.insert("active", i % 3 != 0);
+        record.insert("score", i * 0.25);
+        if (i % 2)
+            doc.insert("record" + to_string(i), record);
+        else
+            sessions.insert("session" + to_string(i), record);
+    }
+    JsonArray counters;
+    for (int i = 0; i < RECORD_COUNT * 5; i++)
+        counters.insert(i * 7);
+    doc.insert("sessions", sessions);
+    doc.insert("counters", counters);
+    return doc;
+}
+
+// 输出ROUNDS次，返回每秒输出的字节数
+template <typename Output>
+double measure(Output output)
+{
+    ulong size = 0;
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        size += output().size();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return size / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    ulong max_threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+    JsonObject doc = build_document();
+    for (long indent : {-1L, 0L})
+    {
+        string expected = doc.output_to_string(indent);
+        printf("indent:%ld size:%lu bytes\n", indent, expected.size());
+        double sequential = measure([&]() { return doc.output_to_string(indent); });
+        printf("sequential      MB/s:%8.1f\n", sequential / 1e6);
+        for (ulong threads = 1; threads <= max_threads; threads *= 2)
+        {
+            if (doc.output_parallel(indent, threads) != expected)
+            {
+                printf("output differs with %lu threads\n", threads);
+                return 1;
+            }
+            double rate = measure([&]() { return doc.output_parallel(indent, threads); });
+            printf("%2lu threads      MB/s:%8.1f speedup:%5.2f\n", threads, rate / 1e6, rate / sequential);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+// 对比完整解析和只构造投影选中字段的解析速度，文档为约50KB的事件，只读取其中很少的几个字段
+// 编译：g++ -std=c++17 -O2 projection_parse.cpp -o projection_parse
+// 运行：./projection_parse
+#include "../Shanhj_Json.hpp"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace Shanhj_Json;
+
+const int EVENT_COUNT = 200;
+const int ROUNDS = 20;
+
+// 构造一个事件：少量元数据，加上一个很大的payload对象
+string build_event(int id)
+{
+    string event = "{\"id\": " + to_string(id) + ", \"type\": \"click\", \"user\": {\"id\": " + to_string(id * 7) +
+                   ", \"name\": \"user" + to_string(id) + "\", \"email\": \"user" + to_string(id) + "@example.com\"}, ";
+    event += "\"payload\": {\"samples\": [";
+    for (int i = 0; i < 560; i++)
+    {
+        if (i) event += ", ";
+        event += "{\"t\": " + to_string(i * 13) + ", \"x\": " + to_string(i * 0.5) + ", \"label\": \"sample point " +
+                 to_string(i) + "\", \"flags\": [true, false, null]}";
+    }
+    return event + "], \"note\": \"" + string(2000, 'n') + "\"}}";
+}
+
+// 解析所有事件ROUNDS次，返回每秒解析的字节数，count为读取到的user.id之和，用来确认两种方式结果相同
+double measure(Parser &parser, vector<string> &events, int64_t &count)
+{
+    JsonObject event, user;
+    bool result = false;
+    ulong size = 0;
+    count = 0;
+    auto begin = chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (auto &text : events)
+        {
+            parser.parse(&text[0], &text[0] + text.size(), event, result);
+            int64_t id;
+            if (!result || !event.get_object("user", user) || !user.get_int("id", id)) return 0;
+            count += id;
+            size += text.size();
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return size / seconds;
+}
+
+int main()
+{
+    vector<string> events;
+    for (int i = 0; i < EVENT_COUNT; i++)
+        events.push_back(build_event(i));
+    printf("event size:%lu bytes\n", events[0].size());
+
+    Parser full_parser;
+    int64_t full_count;
+    double full = measure(full_parser, events, full_count);
+
+    JsonProjection projection;
+    projection.add("/type");
+    projection.add("/user/id");
+    Parser projected_parser;
+    projected_parser.projection = &projection;
+    int64_t projected_count;
+    double projected = measure(projected_parser, events, projected_count);
+    if (full == 0 || projected == 0 || full_count != projected_count)
+    {
+        printf("results differ\n");
+        return 1;
+    }
+    printf("full      MB/s:%8.1f\n", full / 1e6);
+    printf("projected MB/s:%8.1f speedup:%5.2f\n", projected / 1e6, projected / full);
+    return 0;
+}